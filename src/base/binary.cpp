@@ -0,0 +1,119 @@
+/*
+** Taiga
+** Copyright (C) 2010-2018, Eren Okka
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+
+#include "binary.h"
+
+namespace base {
+
+void BinaryWriter::WriteBytes(const void* data, size_t size) {
+  data_.append(static_cast<const char*>(data), size);
+}
+
+void BinaryWriter::WriteInt32(int32_t value) {
+  WriteBytes(&value, sizeof(value));
+}
+
+void BinaryWriter::WriteUInt32(uint32_t value) {
+  WriteBytes(&value, sizeof(value));
+}
+
+void BinaryWriter::WriteUInt64(uint64_t value) {
+  WriteBytes(&value, sizeof(value));
+}
+
+void BinaryWriter::WriteString(const std::wstring& str) {
+  WriteUInt32(static_cast<uint32_t>(str.size()));
+  WriteBytes(str.data(), str.size() * sizeof(wchar_t));
+}
+
+const std::string& BinaryWriter::data() const {
+  return data_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BinaryReader::BinaryReader(const char* data, size_t size)
+    : data_(data), size_(size), position_(0) {
+}
+
+bool BinaryReader::ReadBytes(void* data, size_t size) {
+  if (size > remaining())
+    return false;
+
+  if (size)
+    std::memcpy(data, data_ + position_, size);
+  position_ += size;
+  return true;
+}
+
+bool BinaryReader::ReadInt32(int32_t& value) {
+  return ReadBytes(&value, sizeof(value));
+}
+
+bool BinaryReader::ReadUInt32(uint32_t& value) {
+  return ReadBytes(&value, sizeof(value));
+}
+
+bool BinaryReader::ReadUInt64(uint64_t& value) {
+  return ReadBytes(&value, sizeof(value));
+}
+
+bool BinaryReader::ReadString(std::wstring& str) {
+  uint32_t size = 0;
+  if (!ReadUInt32(size) || size > remaining() / sizeof(wchar_t))
+    return false;
+
+  str.resize(size);
+  return ReadBytes(&str[0], size * sizeof(wchar_t));
+}
+
+size_t BinaryReader::position() const {
+  return position_;
+}
+
+size_t BinaryReader::remaining() const {
+  return size_ - position_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Checksum::Update(const void* data, size_t size) {
+  const auto bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    value_ ^= bytes[i];
+    value_ *= 0x100000001b3;
+  }
+}
+
+void Checksum::Update(int32_t value) {
+  Update(&value, sizeof(value));
+}
+
+void Checksum::Update(const std::wstring& str) {
+  // Including the size keeps adjacent strings from running into each other
+  Update(static_cast<int32_t>(str.size()));
+  Update(str.data(), str.size() * sizeof(wchar_t));
+}
+
+uint64_t Checksum::value() const {
+  return value_;
+}
+
+}  // namespace base
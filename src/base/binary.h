@@ -0,0 +1,76 @@
+/*
+** Taiga
+** Copyright (C) 2010-2018, Eren Okka
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace base {
+
+// Appends values to a buffer in native byte order
+class BinaryWriter {
+public:
+  void WriteBytes(const void* data, size_t size);
+  void WriteInt32(int32_t value);
+  void WriteUInt32(uint32_t value);
+  void WriteUInt64(uint64_t value);
+  void WriteString(const std::wstring& str);
+
+  const std::string& data() const;
+
+private:
+  std::string data_;
+};
+
+// Reads values written by BinaryWriter, failing instead of reading past the
+// end of the buffer
+class BinaryReader {
+public:
+  BinaryReader(const char* data, size_t size);
+
+  bool ReadBytes(void* data, size_t size);
+  bool ReadInt32(int32_t& value);
+  bool ReadUInt32(uint32_t& value);
+  bool ReadUInt64(uint64_t& value);
+  bool ReadString(std::wstring& str);
+
+  size_t position() const;
+  size_t remaining() const;
+
+private:
+  const char* data_;
+  size_t size_;
+  size_t position_;
+};
+
+// 64-bit FNV-1a hash, used for detecting changes in the data that a file was
+// generated from
+class Checksum {
+public:
+  void Update(const void* data, size_t size);
+  void Update(int32_t value);
+  void Update(const std::wstring& str);
+
+  uint64_t value() const;
+
+private:
+  uint64_t value_ = 0xcbf29ce484222325;
+};
+
+}  // namespace base
@@ -106,6 +106,22 @@ QWORD GetFileSize(const std::wstring& path) {
   return file_size;
 }
 
+QWORD GetFileLastWriteTime(const std::wstring& path) {
+  QWORD write_time = 0;
+
+  HANDLE file_handle = OpenFileForGenericRead(path);
+
+  if (file_handle != INVALID_HANDLE_VALUE) {
+    FILETIME ft_file;
+    if (::GetFileTime(file_handle, nullptr, nullptr, &ft_file))
+      write_time = (static_cast<QWORD>(ft_file.dwHighDateTime) << 32) |
+                   ft_file.dwLowDateTime;
+    CloseHandle(file_handle);
+  }
+
+  return write_time;
+}
+
 QWORD GetFolderSize(const std::wstring& path, bool recursive) {
   QWORD folder_size = 0;
   const QWORD max_dword = static_cast<QWORD>(MAXDWORD) + 1;
@@ -422,6 +438,125 @@ bool SaveToFile(const std::string& data, const std::wstring& path,
   return SaveToFile((LPCVOID)&data.front(), data.size(), path, take_backup);
 }
 
+bool SaveToFileAtomic(const std::string& data, const std::wstring& path) {
+  if (data.empty())
+    return false;
+
+  // Make sure the path is available
+  CreateFolder(GetPathOnly(path));
+
+  // Write to a temporary file first, so that an interrupted write never
+  // leaves a truncated file behind
+  const std::wstring temp_path = path + L".tmp";
+
+  BOOL result = FALSE;
+  HANDLE file_handle = OpenFileForGenericWrite(temp_path);
+  if (file_handle != INVALID_HANDLE_VALUE) {
+    DWORD bytes_written = 0;
+    result = ::WriteFile(file_handle, &data.front(),
+                         static_cast<DWORD>(data.size()), &bytes_written,
+                         nullptr);
+    if (result)
+      result = ::FlushFileBuffers(file_handle);
+    ::CloseHandle(file_handle);
+  }
+
+  if (result)
+    result = ::MoveFileEx(GetExtendedLengthPath(temp_path).c_str(),
+                          GetExtendedLengthPath(path).c_str(),
+                          MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+  if (!result)
+    ::DeleteFile(GetExtendedLengthPath(temp_path).c_str());
+
+  return result != FALSE;
+}
+
+bool AppendToFile(const std::string& data, const std::wstring& path) {
+  if (data.empty())
+    return false;
+
+  // Make sure the path is available
+  CreateFolder(GetPathOnly(path));
+
+  BOOL result = FALSE;
+  HANDLE file_handle = ::CreateFile(GetExtendedLengthPath(path).c_str(),
+                                    FILE_APPEND_DATA, 0, nullptr, OPEN_ALWAYS,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_handle != INVALID_HANDLE_VALUE) {
+    DWORD bytes_written = 0;
+    result = ::WriteFile(file_handle, &data.front(),
+                         static_cast<DWORD>(data.size()), &bytes_written,
+                         nullptr);
+    // Data must be on the disk before the change is considered saved
+    if (result)
+      result = ::FlushFileBuffers(file_handle);
+    ::CloseHandle(file_handle);
+  }
+
+  return result != FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+FileMapping::~FileMapping() {
+  Close();
+}
+
+bool FileMapping::Open(const std::wstring& path) {
+  Close();
+
+  file_handle_ = OpenFileForGenericRead(path);
+  if (file_handle_ == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER file_size{};
+  if (::GetFileSizeEx(file_handle_, &file_size) == FALSE ||
+      file_size.QuadPart == 0 ||
+      static_cast<ULONGLONG>(file_size.QuadPart) > SIZE_MAX) {
+    Close();
+    return false;
+  }
+
+  mapping_handle_ = ::CreateFileMapping(file_handle_, nullptr, PAGE_READONLY,
+                                        0, 0, nullptr);
+  if (!mapping_handle_) {
+    Close();
+    return false;
+  }
+
+  data_ = static_cast<const char*>(
+      ::MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+  if (!data_) {
+    Close();
+    return false;
+  }
+
+  size_ = static_cast<size_t>(file_size.QuadPart);
+  return true;
+}
+
+void FileMapping::Close() {
+  if (data_)
+    ::UnmapViewOfFile(data_);
+  if (mapping_handle_)
+    ::CloseHandle(mapping_handle_);
+  if (file_handle_ != INVALID_HANDLE_VALUE)
+    ::CloseHandle(file_handle_);
+
+  file_handle_ = INVALID_HANDLE_VALUE;
+  mapping_handle_ = nullptr;
+  data_ = nullptr;
+  size_ = 0;
+}
+
+const char* FileMapping::data() const {
+  return data_;
+}
+
+size_t FileMapping::size() const {
+  return size_;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 enum Unit : UINT64 {
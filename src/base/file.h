@@ -30,6 +30,7 @@
 unsigned long GetFileAge(const std::wstring& path);
 std::wstring GetFileLastModifiedDate(const std::wstring& path);
 QWORD GetFileSize(const std::wstring& path);
+QWORD GetFileLastWriteTime(const std::wstring& path);
 QWORD GetFolderSize(const std::wstring& path, bool recursive);
 
 bool Execute(const std::wstring& path, const std::wstring& parameters = L"", int show_command = SW_SHOWNORMAL);
@@ -61,6 +62,29 @@ int PopulateFolders(std::vector<std::wstring>& folder_list, const std::wstring&
 bool ReadFromFile(const std::wstring& path, std::string& output);
 bool SaveToFile(LPCVOID data, DWORD length, const std::wstring& path, bool take_backup = false);
 bool SaveToFile(const std::string& data, const std::wstring& path, bool take_backup = false);
+bool SaveToFileAtomic(const std::string& data, const std::wstring& path);
+bool AppendToFile(const std::string& data, const std::wstring& path);
+
+// Read-only view of a file that is mapped into memory
+class FileMapping {
+public:
+  FileMapping() = default;
+  FileMapping(const FileMapping&) = delete;
+  FileMapping& operator=(const FileMapping&) = delete;
+  ~FileMapping();
+
+  bool Open(const std::wstring& path);
+  void Close();
+
+  const char* data() const;
+  size_t size() const;
+
+private:
+  HANDLE file_handle_ = INVALID_HANDLE_VALUE;
+  HANDLE mapping_handle_ = nullptr;
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
 
 UINT64 ParseSizeString(std::wstring value);
 std::wstring ToSizeString(const UINT64 size);
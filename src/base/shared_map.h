@@ -0,0 +1,101 @@
+/*
+** Taiga
+** Copyright (C) 2010-2018, Eren Okka
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <functional>
+#include <map>
+#include <memory>
+
+namespace base {
+
+// An ordered map that is split into shards by the hash of its keys. Copies of
+// the map share their shards until they are modified, so that copying is cheap
+// and modifying a copy only duplicates the shards that it touches. Entries are
+// ordered within each shard, but not across shards.
+template <class key_type, class mapped_type, size_t shard_count = 256,
+          class hasher = std::hash<key_type>>
+class shared_map {
+public:
+  typedef std::map<key_type, mapped_type> shard_type;
+
+  const mapped_type* find(const key_type& key) const {
+    const auto& shard = shards_[shard_index(key)];
+    if (!shard)
+      return nullptr;
+    auto it = shard->find(key);
+    return it != shard->end() ? &it->second : nullptr;
+  }
+
+  bool contains(const key_type& key) const {
+    return find(key) != nullptr;
+  }
+
+  size_t size() const {
+    size_t result = 0;
+    for (const auto& shard : shards_)
+      if (shard)
+        result += shard->size();
+    return result;
+  }
+
+  mapped_type& operator[] (const key_type& key) {
+    return mutable_shard(shard_index(key))[key];
+  }
+
+  // Unlike operator[], does not copy a shared shard if the key is not found
+  mapped_type* find_mutable(const key_type& key) {
+    if (!find(key))
+      return nullptr;
+    return &mutable_shard(shard_index(key)).find(key)->second;
+  }
+
+  void erase(const key_type& key) {
+    if (find(key))
+      mutable_shard(shard_index(key)).erase(key);
+  }
+
+  template <class Function>
+  void for_each(Function function) const {
+    for (const auto& shard : shards_)
+      if (shard)
+        for (const auto& pair : *shard)
+          function(pair.first, pair.second);
+  }
+
+private:
+  static size_t shard_index(const key_type& key) {
+    return hasher()(key) % shard_count;
+  }
+
+  shard_type& mutable_shard(size_t index) {
+    auto& shard = shards_[index];
+    // A shard that no other map refers to can be modified in place
+    if (!shard) {
+      shard = std::make_shared<shard_type>();
+    } else if (shard.use_count() > 1) {
+      shard = std::make_shared<shard_type>(*shard);
+    }
+    return *shard;
+  }
+
+  std::array<std::shared_ptr<shard_type>, shard_count> shards_;
+};
+
+}  // namespace base
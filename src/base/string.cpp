@@ -24,6 +24,12 @@
 #include <regex>
 #include <sstream>
 
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || \
+    defined(__SSE2__)
+#define TAIGA_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 #include "string.h"
 
 using std::string;
@@ -251,8 +257,59 @@ bool SearchRegex(const wstring& str, const wstring& pattern) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-size_t LongestCommonSubsequenceLength(const wstring& str1,
-                                      const wstring& str2) {
+// Patterns longer than this are rare enough that we fall back to the scalar
+// implementations, rather than allocating memory for the state of the
+// bit-parallel ones.
+constexpr size_t kMaxPatternBlocks = 8;
+
+static inline size_t CountBits(uint64_t x) {
+  x = x - ((x >> 1) & 0x5555555555555555);
+  x = (x & 0x3333333333333333) + ((x >> 2) & 0x3333333333333333);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0F;
+  return static_cast<size_t>((x * 0x0101010101010101) >> 56);
+}
+
+static inline size_t GetLowestBitIndex(uint64_t x) {
+  return CountBits((x & (0 - x)) - 1);
+}
+
+PatternMatchVector::PatternMatchVector(const wstring& str)
+    : str_(str),
+      block_count_((str.size() + 63) / 64),
+      ascii_(block_count_ * 128) {
+  for (size_t i = 0; i < str.size(); ++i) {
+    const wchar_t c = str[i];
+    const size_t block = i / 64;
+    const uint64_t bit = uint64_t{1} << (i % 64);
+    if (c < 128) {
+      ascii_[block * 128 + c] |= bit;
+    } else {
+      extended_.push_back({c, block, bit});
+    }
+  }
+
+  std::sort(extended_.begin(), extended_.end(),
+      [](const Entry& a, const Entry& b) {
+        return a.c < b.c || (a.c == b.c && a.block < b.block);
+      });
+
+  // Merge the masks of repeated characters
+  size_t size = 0;
+  for (const auto& entry : extended_) {
+    if (size && extended_[size - 1].c == entry.c &&
+        extended_[size - 1].block == entry.block) {
+      extended_[size - 1].mask |= entry.mask;
+    } else {
+      extended_[size++] = entry;
+    }
+  }
+  extended_.resize(size);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static size_t LongestCommonSubsequenceLengthScalar(std::wstring_view str1,
+                                                   std::wstring_view str2) {
   if (str1.empty() || str2.empty())
     return 0;
 
@@ -276,6 +333,55 @@ size_t LongestCommonSubsequenceLength(const wstring& str1,
   return table.back().back();
 }
 
+size_t LongestCommonSubsequenceLength(const wstring& str1,
+                                      const wstring& str2) {
+  if (str1.empty() || str2.empty())
+    return 0;
+
+  if (str2.size() > kMaxPatternBlocks * 64)
+    return LongestCommonSubsequenceLengthScalar(str1, str2);
+
+  return LongestCommonSubsequenceLength(str1, PatternMatchVector(str2));
+}
+
+// Based on Hyyro's bit-parallel LCS algorithm, where the zero bits of the
+// vector mark the characters of the pattern that are part of the subsequence
+size_t LongestCommonSubsequenceLength(std::wstring_view str1,
+                                      const PatternMatchVector& str2) {
+  const size_t len2 = str2.str().size();
+  const size_t blocks = str2.block_count();
+
+  if (str1.empty() || !len2)
+    return 0;
+
+  if (blocks > kMaxPatternBlocks)
+    return LongestCommonSubsequenceLengthScalar(str1, str2.str());
+
+  uint64_t v[kMaxPatternBlocks];
+  std::fill_n(v, blocks, ~uint64_t{0});
+
+  for (const auto c : str1) {
+    uint64_t carry = 0;
+    for (size_t b = 0; b < blocks; ++b) {
+      const uint64_t u = v[b] & str2.get(b, c);
+      const uint64_t x = v[b] + u;
+      const uint64_t sum = x + carry;
+      carry = (x < u) | (sum < x);
+      v[b] = sum | (v[b] - u);
+    }
+  }
+
+  size_t length = 0;
+  for (size_t b = 0; b < blocks; ++b) {
+    uint64_t mask = ~uint64_t{0};
+    if (b + 1 == blocks && len2 % 64)
+      mask = (uint64_t{1} << (len2 % 64)) - 1;
+    length += CountBits(~v[b] & mask);
+  }
+
+  return length;
+}
+
 size_t LongestCommonSubstringLength(const wstring& str1, const wstring& str2) {
   if (str1.empty() || str2.empty())
     return 0;
@@ -313,7 +419,8 @@ size_t LongestCommonSubstringLength(const wstring& str1, const wstring& str2) {
 
 // Based on Miguel Serrano's Jaro-Winkler distance implementation
 // Licensed under GNU GPLv3 - Copyright (C) 2011 Miguel Serrano
-double JaroWinklerDistance(const wstring& str1, const wstring& str2) {
+static double JaroWinklerDistanceScalar(std::wstring_view str1,
+                                        std::wstring_view str2) {
   const int len1 = str1.size();
   const int len2 = str2.size();
 
@@ -373,7 +480,8 @@ double JaroWinklerDistance(const wstring& str1, const wstring& str2) {
   return dw;
 }
 
-double LevenshteinDistance(const wstring& str1, const wstring& str2) {
+static size_t EditDistanceScalar(std::wstring_view str1,
+                                 std::wstring_view str2) {
   const size_t len1 = str1.size();
   const size_t len2 = str2.size();
 
@@ -393,8 +501,155 @@ double LevenshteinDistance(const wstring& str1, const wstring& str2) {
     col.swap(prev_col);
   }
 
+  return prev_col[len2];
+}
+
+static double LevenshteinDistanceScalar(std::wstring_view str1,
+                                        std::wstring_view str2) {
   const double len = static_cast<double>(std::max(str1.size(), str2.size()));
-  return 1.0 - (prev_col[len2] / len);
+  return 1.0 - (EditDistanceScalar(str1, str2) / len);
+}
+
+double JaroWinklerDistance(const wstring& str1, const wstring& str2) {
+  if (str2.size() > 64)
+    return JaroWinklerDistanceScalar(str1, str2);
+
+  return JaroWinklerDistance(str1, PatternMatchVector(str2));
+}
+
+// Same as the scalar implementation, except that the flags are kept in bit
+// vectors, and matching characters are found with a single lookup
+double JaroWinklerDistance(std::wstring_view str1,
+                           const PatternMatchVector& str2) {
+  const wstring& s2 = str2.str();
+  const int len1 = str1.size();
+  const int len2 = s2.size();
+
+  if (!len1 || !len2)
+    return 0.0;
+
+  if (len1 > 64 || len2 > 64)
+    return JaroWinklerDistanceScalar(str1, s2);
+
+  // Positions in str1 that hold the character at each position of str2
+  uint64_t positions[64] = {};
+  for (int j = 0; j < len1; j++) {
+    for (auto bits = str2.get(0, str1[j]); bits; bits &= bits - 1)
+      positions[GetLowestBitIndex(bits)] |= uint64_t{1} << j;
+  }
+
+  int i, l;
+  int m = 0, t = 0;
+  uint64_t sflags = 0, aflags = 0;
+
+  // Calculate matching characters
+  int range = std::max(0, (std::max(len1, len2) / 2) - 1);
+  for (i = 0; i < len2; i++) {
+    const int begin = std::max(i - range, 0);
+    const int end = std::min(i + range + 1, len1);
+    if (begin >= end)
+      continue;
+    const uint64_t window = (end - begin < 64 ?
+        (uint64_t{1} << (end - begin)) - 1 : ~uint64_t{0}) << begin;
+    const uint64_t matches = positions[i] & window & ~sflags;
+    if (matches) {
+      sflags |= matches & (0 - matches);
+      aflags |= uint64_t{1} << i;
+      m++;
+    }
+  }
+  if (!m)
+    return 0.0;
+
+  // Calculate character transpositions
+  for (uint64_t a = aflags, s = sflags; a; a &= a - 1, s &= s - 1) {
+    if (s2[GetLowestBitIndex(a)] != str1[GetLowestBitIndex(s)])
+      t++;
+  }
+  t /= 2;
+
+  // Jaro distance
+  double dw = ((static_cast<double>(m) / len1) +
+               (static_cast<double>(m) / len2) +
+               (static_cast<double>(m - t) / m)) / 3.0;
+
+  // Calculate common string prefix up to 4 chars
+  l = 0;
+  for (i = 0; i < std::min(std::min(len1, len2), 4); i++)
+    if (str1[i] == s2[i])
+        l++;
+
+  // Jaro-Winkler distance
+  const double scaling_factor = 0.1;
+  dw = dw + (l * scaling_factor * (1.0 - dw));
+
+  return dw;
+}
+
+double LevenshteinDistance(const wstring& str1, const wstring& str2) {
+  if (str2.size() > kMaxPatternBlocks * 64)
+    return LevenshteinDistanceScalar(str1, str2);
+
+  return LevenshteinDistance(str1, PatternMatchVector(str2));
+}
+
+double LevenshteinDistance(std::wstring_view str1,
+                           const PatternMatchVector& str2) {
+  const size_t len1 = str1.size();
+  const size_t len2 = str2.str().size();
+
+  const double len = static_cast<double>(std::max(len1, len2));
+  return 1.0 - (EditDistance(str1, str2) / len);
+}
+
+// Based on Myers' bit-vector algorithm, where each block of the pattern keeps
+// the vertical deltas of its column, and passes the horizontal delta of its
+// last row to the next block
+size_t EditDistance(std::wstring_view str1, const PatternMatchVector& str2) {
+  const size_t len2 = str2.str().size();
+  const size_t blocks = str2.block_count();
+
+  if (blocks > kMaxPatternBlocks)
+    return EditDistanceScalar(str1, str2.str());
+
+  uint64_t vp[kMaxPatternBlocks];
+  uint64_t vn[kMaxPatternBlocks];
+  std::fill_n(vp, blocks, ~uint64_t{0});
+  std::fill_n(vn, blocks, uint64_t{0});
+
+  const uint64_t last_bit = len2 ? uint64_t{1} << ((len2 - 1) % 64) : 0;
+  int distance = static_cast<int>(len2);
+
+  for (const auto c : str1) {
+    int h = 1;  // Distances in the first row increase by one
+    for (size_t b = 0; b < blocks; ++b) {
+      uint64_t eq = str2.get(b, c);
+      const uint64_t xv = eq | vn[b];
+      if (h < 0)
+        eq |= 1;
+      const uint64_t xh = (((eq & vp[b]) + vp[b]) ^ vp[b]) | eq;
+      uint64_t ph = vn[b] | ~(xh | vp[b]);
+      uint64_t mh = vp[b] & xh;
+
+      const uint64_t high_bit = b + 1 < blocks ? uint64_t{1} << 63 : last_bit;
+      const int h_out = (ph & high_bit) ? 1 : (mh & high_bit) ? -1 : 0;
+
+      ph <<= 1;
+      mh <<= 1;
+      if (h < 0) {
+        mh |= 1;
+      } else if (h > 0) {
+        ph |= 1;
+      }
+      vp[b] = mh | ~(xv | ph);
+      vn[b] = ph & xv;
+
+      h = h_out;
+    }
+    distance += h;
+  }
+
+  return distance;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -402,36 +657,87 @@ double LevenshteinDistance(const wstring& str1, const wstring& str2) {
 void GetTrigrams(const wstring& str, trigram_container_t& output) {
   const size_t n = 3;
 
-  if (n < 1)
-    return;
-
   output.clear();
 
+  auto pack = [&str](size_t pos) {
+    trigram_t trigram = 0;
+    for (size_t i = 0; i < n; ++i) {
+      const wchar_t c = pos + i < str.size() ? str[pos + i] : L'\0';
+      trigram = (trigram << 16) | static_cast<uint16_t>(c);
+    }
+    return trigram << 16;
+  };
+
   if (n >= str.size()) {
-    trigram_t buffer = {'\0'};
-    std::copy(str.begin(), str.end(), buffer.begin());
-    output.push_back(buffer);
+    output.push_back(pack(0));
     return;
   }
 
-  for (size_t i = 0; i <= str.size() - n; ++i) {
-    trigram_t buffer = {'\0'};
-    std::copy(str.begin() + i, str.begin() + (i + n), buffer.begin());
-    output.push_back(buffer);
-  }
+  output.reserve(str.size() - n + 1);
+  for (size_t i = 0; i <= str.size() - n; ++i)
+    output.push_back(pack(i));
 
   std::sort(output.begin(), output.end());
+
+  // Number the repeated trigrams, so that the intersection of two containers
+  // counts each trigram as many times as it appears in both strings
+  for (size_t i = 1; i < output.size(); ++i) {
+    if ((output[i] >> 16) == (output[i - 1] >> 16))
+      output[i] = output[i - 1] + 1;
+  }
+}
+
+size_t CountSortedIntersection(const uint64_t* a, size_t a_size,
+                               const uint64_t* b, size_t b_size) {
+  size_t count = 0;
+  size_t i = 0;
+  size_t j = 0;
+
+#ifdef TAIGA_USE_SSE2
+  // Compare blocks of two elements against each other, including the rotated
+  // block. Since the elements are unique, each one can match at most once.
+  auto equal_epi64 = [](__m128i x, __m128i y) {
+    const __m128i eq = _mm_cmpeq_epi32(x, y);
+    return _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+  };
+  while (i + 2 <= a_size && j + 2 <= b_size) {
+    const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+    const __m128i vb_rotated = _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2));
+    const __m128i matches = _mm_or_si128(equal_epi64(va, vb),
+                                         equal_epi64(va, vb_rotated));
+    const int mask = _mm_movemask_pd(_mm_castsi128_pd(matches));
+    count += (mask & 1) + (mask >> 1);
+    const uint64_t a_max = a[i + 1];
+    const uint64_t b_max = b[j + 1];
+    i += a_max <= b_max ? 2 : 0;
+    j += b_max <= a_max ? 2 : 0;
+  }
+#endif
+
+  while (i < a_size && j < b_size) {
+    const uint64_t x = a[i];
+    const uint64_t y = b[j];
+    count += x == y;
+    i += x <= y;
+    j += y <= x;
+  }
+
+  return count;
 }
 
 double CompareTrigrams(const trigram_container_t& t1,
                        const trigram_container_t& t2) {
-  trigram_container_t intersection;
+  return CompareTrigrams(t1.data(), t1.size(), t2.data(), t2.size());
+}
 
-  std::set_intersection(t1.begin(), t1.end(), t2.begin(), t2.end(),
-                        std::back_inserter(intersection));
+double CompareTrigrams(const trigram_t* t1, size_t t1_size,
+                       const trigram_t* t2, size_t t2_size) {
+  const size_t intersection_size =
+      CountSortedIntersection(t1, t1_size, t2, t2_size);
 
-  return static_cast<double>(intersection.size()) /
-         static_cast<double>(std::max(t1.size(), t2.size()));
+  return static_cast<double>(intersection_size) /
+         static_cast<double>(std::max(t1_size, t2_size));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
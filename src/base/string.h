@@ -18,8 +18,10 @@
 
 #pragma once
 
-#include <array>
+#include <algorithm>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <windows.h>
 
@@ -57,15 +59,61 @@ bool IntersectsWith(const std::wstring& str1, const std::wstring& str2);
 bool MatchRegex(const std::wstring& str, const std::wstring& pattern);
 bool SearchRegex(const std::wstring& str, const std::wstring& pattern);
 
+// Bit masks of the positions of each character in a string. Building one for
+// a query lets us compare it against many strings with bit-parallel algorithms
+// without allocating memory for each comparison.
+class PatternMatchVector {
+public:
+  explicit PatternMatchVector(const std::wstring& str);
+
+  uint64_t get(size_t block, wchar_t c) const {
+    if (c < 128)
+      return ascii_[block * 128 + c];
+    auto it = std::lower_bound(extended_.begin(), extended_.end(),
+                               std::make_pair(c, block),
+        [](const Entry& entry, const std::pair<wchar_t, size_t>& key) {
+          return entry.c < key.first ||
+                 (entry.c == key.first && entry.block < key.second);
+        });
+    if (it != extended_.end() && it->c == c && it->block == block)
+      return it->mask;
+    return 0;
+  }
+
+  size_t block_count() const { return block_count_; }
+  const std::wstring& str() const { return str_; }
+
+private:
+  struct Entry {
+    wchar_t c;
+    size_t block;
+    uint64_t mask;
+  };
+
+  std::wstring str_;
+  size_t block_count_ = 0;
+  std::vector<uint64_t> ascii_;
+  std::vector<Entry> extended_;
+};
+
 size_t LongestCommonSubsequenceLength(const std::wstring& str1, const std::wstring& str2);
+size_t LongestCommonSubsequenceLength(std::wstring_view str1, const PatternMatchVector& str2);
 size_t LongestCommonSubstringLength(const std::wstring& str1, const std::wstring& str2);
 double JaroWinklerDistance(const std::wstring& str1, const std::wstring& str2);
+double JaroWinklerDistance(std::wstring_view str1, const PatternMatchVector& str2);
 double LevenshteinDistance(const std::wstring& str1, const std::wstring& str2);
+double LevenshteinDistance(std::wstring_view str1, const PatternMatchVector& str2);
+size_t EditDistance(std::wstring_view str1, const PatternMatchVector& str2);
 
-typedef std::array<wchar_t, 3> trigram_t;
+// Three UTF-16 code units are packed into the upper 48 bits, while the lower
+// 16 bits hold the occurrence index of a repeated trigram. This keeps the
+// elements of a container unique, which lets us intersect them as sets.
+typedef uint64_t trigram_t;
 typedef std::vector<trigram_t> trigram_container_t;
 void GetTrigrams(const std::wstring& str, trigram_container_t& output);
 double CompareTrigrams(const trigram_container_t& t1, const trigram_container_t& t2);
+double CompareTrigrams(const trigram_t* t1, size_t t1_size, const trigram_t* t2, size_t t2_size);
+size_t CountSortedIntersection(const uint64_t* a, size_t a_size, const uint64_t* b, size_t b_size);
 
 void ReplaceChar(std::wstring& str, const wchar_t c, const wchar_t replace_with);
 void ReplaceChars(std::wstring& str, const wchar_t chars[], const std::wstring& replace_with);
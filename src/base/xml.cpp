@@ -24,7 +24,7 @@ struct xml_string_writer: pugi::xml_writer {
   std::string result;
 
   virtual void write(const void* data, size_t size) {
-    result += std::string(static_cast<const char*>(data), size);
+    result.append(static_cast<const char*>(data), size);
   }
 };
 
@@ -72,11 +72,17 @@ void XmlWriteStrValue(pugi::xml_node& node, const wchar_t* name,
   child.append_child(node_type).set_value(value);
 }
 
-bool XmlWriteDocumentToFile(const pugi::xml_document& document,
-                            const std::wstring& path) {
-  CreateFolder(GetPathOnly(path));
+std::string XmlWriteDocumentToString(const pugi::xml_document& document) {
+  xml_string_writer writer;
 
   const pugi::char_t* indent = L"\x09";  // horizontal tab
   unsigned int flags = pugi::format_default | pugi::format_write_bom;
-  return document.save_file(path.c_str(), indent, flags);
+  document.save(writer, indent, flags, pugi::encoding_utf8);
+
+  return writer.result;
+}
+
+bool XmlWriteDocumentToFile(const pugi::xml_document& document,
+                            const std::wstring& path) {
+  return SaveToFileAtomic(XmlWriteDocumentToString(document), path);
 }
\ No newline at end of file
@@ -49,5 +49,6 @@ void XmlWriteStrValue(pugi::xml_node& node, const wchar_t* name,
                       const wchar_t* value,
                       pugi::xml_node_type node_type = pugi::node_pcdata);
 
+std::string XmlWriteDocumentToString(const pugi::xml_document& document);
 bool XmlWriteDocumentToFile(const pugi::xml_document& document,
                             const std::wstring& path);
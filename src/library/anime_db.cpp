@@ -31,6 +31,7 @@
 #include "sync/service.h"
 #include "taiga/http.h"
 #include "taiga/path.h"
+#include "taiga/save_queue.h"
 #include "taiga/settings.h"
 #include "taiga/taiga.h"
 #include "track/recognition.h"
@@ -42,8 +43,15 @@ anime::Database AnimeDatabase;
 namespace anime {
 
 bool Database::LoadDatabase() {
+  // The snapshot is only read if it was written along with the document
+  if (ReadSnapshot())
+    return true;
+
+  return LoadDatabase(taiga::GetPath(taiga::Path::DatabaseAnime));
+}
+
+bool Database::LoadDatabase(const std::wstring& path) {
   xml_document document;
-  std::wstring path = taiga::GetPath(taiga::Path::DatabaseAnime);
   unsigned int options = pugi::parse_default & ~pugi::parse_eol;
   xml_parse_result parse_result = document.load_file(path.c_str(), options);
 
@@ -132,25 +140,48 @@ void Database::ReadDatabaseNode(xml_node& database_node) {
   }
 }
 
-bool Database::SaveDatabase() {
-  xml_document document;
+void Database::SaveDatabase() {
+  const auto database = CopyMetadata();
+
+  auto serialize = [database]() {
+    xml_document document;
 
-  xml_node meta_node = document.append_child(L"meta");
-  XmlWriteStrValue(meta_node, L"version", StrToWstr(Taiga.version.to_string()).c_str());
+    xml_node meta_node = document.append_child(L"meta");
+    XmlWriteStrValue(meta_node, L"version", StrToWstr(Taiga.version.to_string()).c_str());
 
-  xml_node database_node = document.append_child(L"database");
-  WriteDatabaseNode(database_node);
+    xml_node database_node = document.append_child(L"database");
+    WriteDatabaseNode(database_node, *database);
 
+    return XmlWriteDocumentToString(document);
+  };
+
+  auto on_saved = [database](bool saved) {
+    if (saved)
+      WriteSnapshot(*database);
+  };
+
+  // Failures to write the file are logged by the save queue
   std::wstring path = taiga::GetPath(taiga::Path::DatabaseAnime);
-  return XmlWriteDocumentToFile(document, path);
+  taiga::save_queue.Add(path, serialize, on_saved);
 }
 
-void Database::WriteDatabaseNode(xml_node& database_node) {
-  for (const auto& pair : items) {
+std::shared_ptr<const std::vector<Item>> Database::CopyMetadata() const {
+  auto database = std::make_shared<std::vector<Item>>();
+  database->reserve(items.size());
+
+  for (const auto& pair : items)
+    database->push_back(pair.second.CopyMetadata());
+
+  return database;
+}
+
+void Database::WriteDatabaseNode(xml_node& database_node,
+                                 const std::vector<Item>& items) {
+  for (const auto& item : items) {
     xml_node anime_node = database_node.append_child(L"anime");
 
     for (int i = 0; i <= sync::kLastService; i++) {
-      std::wstring id = pair.second.GetId(i);
+      std::wstring id = item.GetId(i);
       if (!id.empty()) {
         xml_node child = anime_node.append_child(L"id");
         std::wstring name = ServiceManager.GetServiceNameById(static_cast<sync::ServiceId>(i));
@@ -160,7 +191,7 @@ void Database::WriteDatabaseNode(xml_node& database_node) {
     }
 
     std::wstring source = ServiceManager.GetServiceNameById(
-        static_cast<sync::ServiceId>(pair.second.GetSource()));
+        static_cast<sync::ServiceId>(item.GetSource()));
 
     #define XML_WC(n, v, t) \
       if (!v.empty()) XmlWriteChildNodes(anime_node, v, n, t)
@@ -173,25 +204,25 @@ void Database::WriteDatabaseNode(xml_node& database_node) {
     #define XML_WF(n, v, t) \
       if (v > 0.0) XmlWriteStrValue(anime_node, n, ToWstr(v).c_str(), t)
     XML_WS(L"source", source, pugi::node_pcdata);
-    XML_WS(L"slug", pair.second.GetSlug(), pugi::node_pcdata);
-    XML_WS(L"title", pair.second.GetTitle(), pugi::node_cdata);
-    XML_WS(L"english", pair.second.GetEnglishTitle(), pugi::node_cdata);
-    XML_WS(L"japanese", pair.second.GetJapaneseTitle(), pugi::node_cdata);
-    XML_WC(L"synonym", pair.second.GetSynonyms(), pugi::node_cdata);
-    XML_WI(L"type", pair.second.GetType());
-    XML_WI(L"status", pair.second.GetAiringStatus());
-    XML_WI(L"episode_count", pair.second.GetEpisodeCount());
-    XML_WI(L"episode_length", pair.second.GetEpisodeLength());
-    XML_WD(L"date_start", pair.second.GetDateStart());
-    XML_WD(L"date_end", pair.second.GetDateEnd());
-    XML_WS(L"image", pair.second.GetImageUrl(), pugi::node_pcdata);
-    XML_WI(L"age_rating", pair.second.GetAgeRating());
-    XML_WS(L"genres", Join(pair.second.GetGenres(), L", "), pugi::node_pcdata);
-    XML_WS(L"producers", Join(pair.second.GetProducers(), L", "), pugi::node_pcdata);
-    XML_WF(L"score", pair.second.GetScore(), pugi::node_pcdata);
-    XML_WI(L"popularity", pair.second.GetPopularity());
-    XML_WS(L"synopsis", pair.second.GetSynopsis(), pugi::node_cdata);
-    XML_WS(L"modified", ToWstr(pair.second.GetLastModified()), pugi::node_pcdata);
+    XML_WS(L"slug", item.GetSlug(), pugi::node_pcdata);
+    XML_WS(L"title", item.GetTitle(), pugi::node_cdata);
+    XML_WS(L"english", item.GetEnglishTitle(), pugi::node_cdata);
+    XML_WS(L"japanese", item.GetJapaneseTitle(), pugi::node_cdata);
+    XML_WC(L"synonym", item.GetSynonyms(), pugi::node_cdata);
+    XML_WI(L"type", item.GetType());
+    XML_WI(L"status", item.GetAiringStatus());
+    XML_WI(L"episode_count", item.GetEpisodeCount());
+    XML_WI(L"episode_length", item.GetEpisodeLength());
+    XML_WD(L"date_start", item.GetDateStart());
+    XML_WD(L"date_end", item.GetDateEnd());
+    XML_WS(L"image", item.GetImageUrl(), pugi::node_pcdata);
+    XML_WI(L"age_rating", item.GetAgeRating());
+    XML_WS(L"genres", Join(item.GetGenres(), L", "), pugi::node_pcdata);
+    XML_WS(L"producers", Join(item.GetProducers(), L", "), pugi::node_pcdata);
+    XML_WF(L"score", item.GetScore(), pugi::node_pcdata);
+    XML_WI(L"popularity", item.GetPopularity());
+    XML_WS(L"synopsis", item.GetSynopsis(), pugi::node_cdata);
+    XML_WS(L"modified", ToWstr(item.GetLastModified()), pugi::node_pcdata);
     #undef XML_WF
     #undef XML_WS
     #undef XML_WI
@@ -217,9 +248,15 @@ Item* Database::FindItem(int id, bool log_error) {
 Item* Database::FindItem(const std::wstring& id, enum_t service,
                          bool log_error) {
   if (!id.empty()) {
-    for (auto& pair : items)
-      if (id == pair.second.GetId(service))
-        return &pair.second;
+    if (static_cast<size_t>(service) < id_indexes_.size()) {
+      const auto& index = id_indexes_.at(service);
+      auto it = index.find(id);
+      if (it != index.end()) {
+        auto item = FindItem(it->second, false);
+        if (item && item->GetId(service) == id)
+          return item;
+      }
+    }
     if (log_error)
       LOGE(L"Could not find ID: {}", id);
   }
@@ -227,6 +264,47 @@ Item* Database::FindItem(const std::wstring& id, enum_t service,
   return nullptr;
 }
 
+void Database::UpdateIdIndex(const Item& item, enum_t service,
+                             const std::wstring& previous_id) {
+  // Only items that are stored in the database are indexed
+  const int key = item.GetId();
+  auto it = items.find(key);
+  if (it == items.end() || &it->second != &item)
+    return;
+
+  if (id_indexes_.size() <= static_cast<size_t>(service))
+    id_indexes_.resize(service + 1);
+  auto& index = id_indexes_.at(service);
+
+  if (!previous_id.empty()) {
+    auto previous = index.find(previous_id);
+    if (previous != index.end() && previous->second == key)
+      index.erase(previous);
+  }
+
+  const auto& id = item.GetId(service);
+  if (id.empty())
+    return;
+
+  auto result = index.emplace(id, key);
+  if (!result.second && result.first->second != key) {
+    // Entries may be stale, e.g. after the items were cleared. Otherwise keep
+    // the lowest key, which is what a search in order would have found.
+    auto other = FindItem(result.first->second, false);
+    if (!other || other->GetId(service) != id || key < result.first->second)
+      result.first->second = key;
+  }
+}
+
+void Database::EraseFromIdIndex(const Item& item, int key) {
+  for (size_t service = 0; service < id_indexes_.size(); ++service) {
+    auto& index = id_indexes_.at(service);
+    auto it = index.find(item.GetId(static_cast<enum_t>(service)));
+    if (it != index.end() && it->second == key)
+      index.erase(it);
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void Database::ClearInvalidItems() {
@@ -234,6 +312,7 @@ void Database::ClearInvalidItems() {
     if (!anime::IsValidId(it->second.GetId()) ||
         it->first != it->second.GetId()) {
       LOGD(L"ID: {}", it->first);
+      EraseFromIdIndex(it->second, it->first);
       items.erase(it++);
     } else {
       ++it;
@@ -245,8 +324,10 @@ bool Database::DeleteItem(int id) {
   std::wstring title;
 
   auto anime_item = FindItem(id, false);
-  if (anime_item)
+  if (anime_item) {
     title = anime_item->GetTitle();
+    EraseFromIdIndex(*anime_item, id);
+  }
 
   if (items.erase(id) > 0) {
     LOGW(L"ID: {} | Title: {}", id, title);
@@ -301,6 +382,12 @@ int Database::UpdateItem(const Item& new_item) {
   // Update series information if new information is, well, new.
   if (!item->GetLastModified() ||
       new_item.GetLastModified() >= item->GetLastModified()) {
+    // Recognition results are validated against these
+    const int episode_count = item->GetEpisodeCount();
+    const int airing_status = item->GetAiringStatus(false);
+    const Date date_start = item->GetDateStart();
+    const Date date_end = item->GetDateEnd();
+
     item->SetLastModified(new_item.GetLastModified());
 
     for (enum_t i = sync::kFirstService; i <= sync::kLastService; i++)
@@ -336,17 +423,24 @@ int Database::UpdateItem(const Item& new_item) {
       item->SetImageUrl(new_item.GetImageUrl());
     if (new_item.GetAgeRating() != kUnknownAgeRating)
       item->SetAgeRating(new_item.GetAgeRating());
-    if (!new_item.GetGenres().empty())
-      item->SetGenres(new_item.GetGenres());
+    if (new_item.HasGenres())
+      item->SetGenreSymbols(new_item.GetGenreSymbols());
     if (new_item.GetPopularity() > 0)
       item->SetPopularity(new_item.GetPopularity());
-    if (!new_item.GetProducers().empty())
-      item->SetProducers(new_item.GetProducers());
+    if (new_item.HasProducers())
+      item->SetProducerSymbols(new_item.GetProducerSymbols());
     if (new_item.GetScore() != kUnknownScore)
       item->SetScore(new_item.GetScore());
     if (!new_item.GetSynopsis().empty())
       item->SetSynopsis(new_item.GetSynopsis());
 
+    // Cached recognition results may no longer be valid
+    if (item->GetEpisodeCount() != episode_count ||
+        item->GetAiringStatus(false) != airing_status ||
+        item->GetDateStart() != date_start ||
+        item->GetDateEnd() != date_end)
+      Meow.InvalidateCache();
+
     // Update clean titles, if necessary
     if (!new_item.GetTitle().empty() ||
         !new_item.GetSynonyms().empty() ||
@@ -409,6 +503,8 @@ bool Database::LoadList() {
   xml_node meta_node = document.child(L"meta");
   std::wstring meta_version = XmlReadStrValue(meta_node, L"version");
 
+  Meow.BeginTitleUpdates();  // Publish all title changes at once
+
   if (!meta_version.empty()) {
     xml_node node_database = document.child(L"database");
     ReadDatabaseNode(node_database);
@@ -443,47 +539,115 @@ bool Database::LoadList() {
     ReadListInCompatibilityMode(document);
   }
 
+  // Changes that were made after the list was last saved
+  const auto journal_sequence = ToUint64(XmlReadStrValue(meta_node, L"journal"));
+  const bool journal_read = ReadListJournal(journal_sequence);
+
+  Meow.EndTitleUpdates();
+
+  if (!journal_read)
+    SaveList();
+
   return true;
 }
 
+// Library data of an item, captured so that the list can be saved on another
+// thread
+struct ListEntry {
+  int id;
+  std::wstring library_id;
+  int progress;
+  std::wstring date_start;
+  std::wstring date_end;
+  int score;
+  int status;
+  int rewatched_times;
+  int rewatching;
+  int rewatching_ep;
+  std::wstring tags;
+  std::wstring notes;
+  std::wstring last_updated;
+};
+
 bool Database::SaveList(bool include_database) {
   if (items.empty())
     return false;
 
-  xml_document document;
+  auto entries = std::make_shared<std::vector<ListEntry>>();
+  for (const auto& pair : items) {
+    auto& item = pair.second;
+    if (item.IsInList()) {
+      entries->push_back({
+          item.GetId(),
+          item.GetMyId(),
+          item.GetMyLastWatchedEpisode(false),
+          std::wstring(item.GetMyDateStart()),
+          std::wstring(item.GetMyDateEnd()),
+          item.GetMyScore(false),
+          item.GetMyStatus(false),
+          item.GetMyRewatchedTimes(),
+          item.GetMyRewatching(false),
+          item.GetMyRewatchingEp(),
+          item.GetMyTags(false),
+          item.GetMyNotes(false),
+          item.GetMyLastUpdated()});
+    }
+  }
 
-  xml_node meta_node = document.append_child(L"meta");
-  XmlWriteStrValue(meta_node, L"version", StrToWstr(Taiga.version.to_string()).c_str());
+  std::shared_ptr<const std::vector<Item>> database;
+  if (include_database)
+    database = CopyMetadata();
 
-  if (include_database) {
-    xml_node node_database = document.append_child(L"database");
-    WriteDatabaseNode(node_database);
+  // Journal entries up to this point are in the list
+  const auto journal_path = taiga::GetPath(taiga::Path::UserLibraryJournal);
+  uint64_t journal_sequence = 0;
+  {
+    std::lock_guard<std::mutex> lock(list_journal_mutex_);
+    journal_sequence = list_journal_sequence_;
   }
 
-  xml_node node_library = document.append_child(L"library");
+  auto serialize = [entries, database, journal_sequence]() {
+    xml_document document;
 
-  for (const auto& pair : items) {
-    auto& item = pair.second;
-    if (item.IsInList()) {
+    xml_node meta_node = document.append_child(L"meta");
+    XmlWriteStrValue(meta_node, L"version", StrToWstr(Taiga.version.to_string()).c_str());
+    XmlWriteStrValue(meta_node, L"journal", ToWstr(journal_sequence).c_str());
+
+    if (database) {
+      xml_node node_database = document.append_child(L"database");
+      WriteDatabaseNode(node_database, *database);
+    }
+
+    xml_node node_library = document.append_child(L"library");
+
+    for (const auto& entry : *entries) {
       xml_node node = node_library.append_child(L"anime");
-      XmlWriteIntValue(node, L"id", item.GetId());
-      XmlWriteStrValue(node, L"library_id", item.GetMyId().c_str());
-      XmlWriteIntValue(node, L"progress", item.GetMyLastWatchedEpisode(false));
-      XmlWriteStrValue(node, L"date_start", std::wstring(item.GetMyDateStart()).c_str());
-      XmlWriteStrValue(node, L"date_end", std::wstring(item.GetMyDateEnd()).c_str());
-      XmlWriteIntValue(node, L"score", item.GetMyScore(false));
-      XmlWriteIntValue(node, L"status", item.GetMyStatus(false));
-      XmlWriteIntValue(node, L"rewatched_times", item.GetMyRewatchedTimes());
-      XmlWriteIntValue(node, L"rewatching", item.GetMyRewatching(false));
-      XmlWriteIntValue(node, L"rewatching_ep", item.GetMyRewatchingEp());
-      XmlWriteStrValue(node, L"tags", item.GetMyTags(false).c_str());
-      XmlWriteStrValue(node, L"notes", item.GetMyNotes(false).c_str());
-      XmlWriteStrValue(node, L"last_updated", item.GetMyLastUpdated().c_str());
+      XmlWriteIntValue(node, L"id", entry.id);
+      XmlWriteStrValue(node, L"library_id", entry.library_id.c_str());
+      XmlWriteIntValue(node, L"progress", entry.progress);
+      XmlWriteStrValue(node, L"date_start", entry.date_start.c_str());
+      XmlWriteStrValue(node, L"date_end", entry.date_end.c_str());
+      XmlWriteIntValue(node, L"score", entry.score);
+      XmlWriteIntValue(node, L"status", entry.status);
+      XmlWriteIntValue(node, L"rewatched_times", entry.rewatched_times);
+      XmlWriteIntValue(node, L"rewatching", entry.rewatching);
+      XmlWriteIntValue(node, L"rewatching_ep", entry.rewatching_ep);
+      XmlWriteStrValue(node, L"tags", entry.tags.c_str());
+      XmlWriteStrValue(node, L"notes", entry.notes.c_str());
+      XmlWriteStrValue(node, L"last_updated", entry.last_updated.c_str());
     }
-  }
+
+    return XmlWriteDocumentToString(document);
+  };
+
+  auto on_saved = [this, journal_path, journal_sequence](bool saved) {
+    if (saved)
+      OnListSaved(journal_path, journal_sequence);
+  };
 
   std::wstring path = taiga::GetPath(taiga::Path::UserLibrary);
-  return XmlWriteDocumentToFile(document, path);
+  taiga::save_queue.Add(path, serialize, on_saved);
+  return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -554,7 +718,7 @@ void Database::AddToList(int anime_id, int status) {
   History.queue.Add(history_item);
 
   SaveDatabase();
-  SaveList();
+  SaveListEntry(anime_id);
 
   ui::OnLibraryEntryAdd(anime_id);
 
@@ -636,7 +800,7 @@ void Database::UpdateItem(const HistoryItem& history_item) {
   if (history_item.mode != taiga::kHttpServiceDeleteLibraryEntry)
     anime::SetMyLastUpdateToNow(*anime_item);
 
-  SaveList();
+  SaveListEntry(history_item.anime_id);
 
   History.queue.Remove();
   History.queue.Check(false);
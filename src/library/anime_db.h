@@ -18,9 +18,15 @@
 
 #pragma once
 
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include "library/anime_item.h"
+#include "library/anime_store.h"
 
 class HistoryItem;
 namespace pugi {
@@ -33,7 +39,8 @@ namespace anime {
 class Database {
 public:
   bool LoadDatabase();
-  bool SaveDatabase();
+  bool LoadDatabase(const std::wstring& path);
+  void SaveDatabase();
 
   Item* FindItem(int id, bool log_error = true);
   Item* FindItem(const std::wstring& id, enum_t service, bool log_error = true);
@@ -44,7 +51,11 @@ public:
 
 public:
   bool LoadList();
+  // Lists are saved in the background. Returns whether the list was queued,
+  // and failures to write it are logged by the save queue.
   bool SaveList(bool include_database = false);
+  bool SaveListEntry(int anime_id);
+  bool CompactListJournal(bool force = false);
 
   int GetItemCount(int status, bool check_history = true);
 
@@ -54,11 +65,39 @@ public:
   void UpdateItem(const HistoryItem& history_item);
 
 public:
-  std::map<int, Item> items;
+  ItemStore items;
 
 private:
+  friend class Item;
+
+  void UpdateIdIndex(const Item& item, enum_t service,
+                     const std::wstring& previous_id);
+  void EraseFromIdIndex(const Item& item, int key);
+
+  // Service IDs to keys of items, kept up to date by Item::SetId
+  std::vector<std::unordered_map<std::wstring, int>> id_indexes_;
+
+  // Copies of items are saved on another thread
+  std::shared_ptr<const std::vector<Item>> CopyMetadata() const;
+
   void ReadDatabaseNode(pugi::xml_node& database_node);
-  void WriteDatabaseNode(pugi::xml_node& database_node);
+  static void WriteDatabaseNode(pugi::xml_node& database_node,
+                                const std::vector<Item>& items);
+  bool ReadSnapshot();
+  static bool WriteSnapshot(const std::vector<Item>& items);
+
+  bool ReadListJournal(uint64_t saved_sequence);
+  void OnListSaved(const std::wstring& journal_path, uint64_t sequence);
+  void DeleteListJournal();
+
+  // The list file records the sequence number of the last journal entry it
+  // includes. Entries are appended on the UI thread, and the journal is
+  // deleted on the thread that saves the list.
+  std::wstring list_journal_path_;
+  uint64_t list_journal_sequence_ = 0;
+  size_t list_journal_size_ = 0;  // in bytes
+  time_t list_journal_time_ = 0;  // of the first entry
+  std::mutex list_journal_mutex_;
 
   bool CheckOldUserDirectory();
   void HandleCompatibility(const std::wstring& meta_version);
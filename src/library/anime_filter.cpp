@@ -58,10 +58,13 @@ bool Filters::FilterText(const Item& item, int text_index) const {
   Split(filter_text, L" ", words);
   RemoveEmptyStrings(words);
 
+  if (words.empty())
+    return true;
+
   std::vector<std::wstring> titles;
   GetAllTitles(item.GetId(), titles);
 
-  const auto& genres = item.GetGenres();
+  const auto genres = item.GetGenres();
 
   for (const auto& word : words) {
     auto check_strings = [&word](const std::vector<std::wstring>& v) {
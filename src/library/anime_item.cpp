@@ -18,11 +18,13 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <mutex>
 
 #include "base/string.h"
 #include "base/time.h"
 #include "library/anime_db.h"
 #include "library/anime_item.h"
+#include "library/anime_snapshot.h"
 #include "library/anime_util.h"
 #include "library/history.h"
 #include "sync/sync.h"
@@ -32,8 +34,37 @@ anime::Database* anime::Item::database_ = &AnimeDatabase;
 
 namespace anime {
 
-Item::Item() {
-  metadata_.uid.resize(sync::kLastService + 1);
+class Item::LazySynopsis {
+public:
+  LazySynopsis(const std::shared_ptr<const DatabaseSnapshot>& snapshot,
+               uint32_t index)
+      : snapshot_(snapshot), index_(index) {
+  }
+
+  const std::wstring& Get() {
+    std::call_once(decoded_, [this]() {
+      value_ = snapshot_->GetString(index_);
+      snapshot_.reset();  // lets the snapshot be released
+    });
+    return value_;
+  }
+
+private:
+  std::once_flag decoded_;
+  std::shared_ptr<const DatabaseSnapshot> snapshot_;
+  uint32_t index_;
+  std::wstring value_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+Item::Item()
+    : metadata_(std::make_shared<library::Metadata>()) {
+  metadata_->uid.resize(sync::kLastService + 1);
+}
+
+Item::Item(const std::shared_ptr<library::Metadata>& metadata)
+    : metadata_(metadata) {
 }
 
 Item::~Item() {
@@ -42,71 +73,71 @@ Item::~Item() {
 ////////////////////////////////////////////////////////////////////////////////
 
 int Item::GetId() const {
-  assert(!metadata_.uid.empty());
+  assert(!metadata_->uid.empty());
 
-  return ToInt(metadata_.uid.at(0));
+  return ToInt(metadata_->uid.at(0));
 }
 
 const std::wstring& Item::GetId(enum_t service) const {
-  assert(metadata_.uid.size() > service);
+  assert(metadata_->uid.size() > service);
 
-  return metadata_.uid.at(service);
+  return metadata_->uid.at(service);
 }
 
 const std::wstring& Item::GetSlug() const {
-  if (metadata_.resource.size() > 1)
-    return metadata_.resource.at(1);
+  if (metadata_->resource.size() > 1)
+    return metadata_->resource.at(1);
 
   return EmptyString();
 }
 
 enum_t Item::GetSource() const {
-  return metadata_.source;
+  return metadata_->source;
 }
 
 int Item::GetType() const {
-  return metadata_.type;
+  return metadata_->type;
 }
 
 int Item::GetEpisodeCount() const {
-  if (metadata_.extent.size() > 0)
-    return metadata_.extent.at(0);
+  if (metadata_->extent.size() > 0)
+    return metadata_->extent.at(0);
 
   return kUnknownEpisodeCount;
 }
 
 int Item::GetEpisodeLength() const {
-  if (metadata_.extent.size() > 1)
-    return metadata_.extent.at(1);
+  if (metadata_->extent.size() > 1)
+    return metadata_->extent.at(1);
 
   return kUnknownEpisodeLength;
 }
 
 int Item::GetAiringStatus(bool check_date) const {
   if (!check_date)
-    return metadata_.status;
+    return metadata_->status;
 
   return anime::GetAiringStatus(*this);
 }
 
 const std::wstring& Item::GetTitle() const {
-  return metadata_.title;
+  return metadata_->title;
 }
 
 const std::wstring& Item::GetEnglishTitle(bool fallback) const {
-  for (const auto& alt_title : metadata_.alternative)
+  for (const auto& alt_title : metadata_->alternative)
     if (alt_title.type == library::TitleType::LangEnglish)
       if (!alt_title.value.empty())
         return alt_title.value;
 
   if (fallback)
-    return metadata_.title;
+    return metadata_->title;
 
   return EmptyString();
 }
 
 const std::wstring& Item::GetJapaneseTitle() const {
-  for (const auto& alt_title : metadata_.alternative)
+  for (const auto& alt_title : metadata_->alternative)
     if (alt_title.type == library::TitleType::LangJapanese)
       if (!alt_title.value.empty())
         return alt_title.value;
@@ -117,7 +148,7 @@ const std::wstring& Item::GetJapaneseTitle() const {
 std::vector<std::wstring> Item::GetSynonyms() const {
   std::vector<std::wstring> synonyms;
 
-  for (const auto& alt_title : metadata_.alternative)
+  for (const auto& alt_title : metadata_->alternative)
     if (alt_title.type == library::TitleType::Synonym)
       synonyms.push_back(alt_title.value);
 
@@ -125,92 +156,123 @@ std::vector<std::wstring> Item::GetSynonyms() const {
 }
 
 const Date& Item::GetDateStart() const {
-  if (metadata_.date.size() > 0)
-    return metadata_.date.at(0);
+  if (metadata_->date.size() > 0)
+    return metadata_->date.at(0);
 
   return EmptyDate();
 }
 
 const Date& Item::GetDateEnd() const {
-  if (metadata_.date.size() > 1)
-    return metadata_.date.at(1);
+  if (metadata_->date.size() > 1)
+    return metadata_->date.at(1);
 
   return EmptyDate();
 }
 
 const std::wstring& Item::GetImageUrl() const {
-  if (metadata_.resource.size() > 0)
-    return metadata_.resource.at(0);
+  if (metadata_->resource.size() > 0)
+    return metadata_->resource.at(0);
 
   return EmptyString();
 }
 
 enum_t Item::GetAgeRating() const {
-  return metadata_.audience;
+  return metadata_->audience;
+}
+
+std::vector<std::wstring> Item::GetGenres() const {
+  return library::GetInternedStrings(metadata_->subject);
 }
 
-const std::vector<std::wstring>& Item::GetGenres() const {
-  return metadata_.subject;
+const std::vector<library::symbol_t>& Item::GetGenreSymbols() const {
+  return metadata_->subject;
+}
+
+bool Item::HasGenre(library::symbol_t genre) const {
+  const auto& genres = metadata_->subject;
+  return std::find(genres.begin(), genres.end(), genre) != genres.end();
+}
+
+bool Item::HasGenres() const {
+  return !metadata_->subject.empty();
 }
 
 int Item::GetPopularity() const {
-  if (metadata_.community.size() > 1)
-    return ToInt(metadata_.community.at(1));
+  if (metadata_->community.size() > 1)
+    return ToInt(metadata_->community.at(1));
 
   return 0;
 }
 
-const std::vector<std::wstring>& Item::GetProducers() const {
-  return metadata_.creator;
+std::vector<std::wstring> Item::GetProducers() const {
+  return library::GetInternedStrings(metadata_->creator);
+}
+
+const std::vector<library::symbol_t>& Item::GetProducerSymbols() const {
+  return metadata_->creator;
+}
+
+bool Item::HasProducers() const {
+  return !metadata_->creator.empty();
 }
 
 double Item::GetScore() const {
-  if (metadata_.community.size() > 0)
-    return ToDouble(metadata_.community.at(0));
+  if (metadata_->community.size() > 0)
+    return ToDouble(metadata_->community.at(0));
 
   return 0.0;
 }
 
 const std::wstring& Item::GetSynopsis() const {
-  return metadata_.description;
+  if (lazy_synopsis_)
+    return lazy_synopsis_->Get();
+
+  return metadata_->description;
 }
 
 const time_t Item::GetLastModified() const {
-  return metadata_.modified;
+  return metadata_->modified;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 void Item::SetId(const std::wstring& id, enum_t service) {
-  if (metadata_.uid.size() < static_cast<size_t>(service) + 1)
-    metadata_.uid.resize(service + 1);
+  if (metadata_->uid.size() < static_cast<size_t>(service) + 1)
+    EditMetadata().uid.resize(service + 1);
 
-  metadata_.uid.at(service) = id;
+  if (metadata_->uid.at(service) == id)
+    return;
+
+  auto& current_id = EditMetadata().uid.at(service);
+  const std::wstring previous_id = current_id;
+  current_id = id;
+
+  database_->UpdateIdIndex(*this, service, previous_id);
 }
 
 void Item::SetSlug(const std::wstring& slug) {
-  if (metadata_.resource.size() < 2) {
+  if (metadata_->resource.size() < 2) {
     if (slug.empty())
       return;
-    metadata_.resource.resize(2);
+    EditMetadata().resource.resize(2);
   }
 
-  metadata_.resource.at(1) = slug;
+  EditMetadata().resource.at(1) = slug;
 }
 
 void Item::SetSource(enum_t source) {
-  metadata_.source = source;
+  EditMetadata().source = source;
 }
 
 void Item::SetType(int type) {
-  metadata_.type = type;
+  EditMetadata().type = type;
 }
 
 void Item::SetEpisodeCount(int number) {
-  if (metadata_.extent.size() < 1)
-    metadata_.extent.resize(1);
+  if (metadata_->extent.size() < 1)
+    EditMetadata().extent.resize(1);
 
-  metadata_.extent.at(0) = number;
+  EditMetadata().extent.at(0) = number;
 
   // TODO: Call it separately
   if (number >= 0)
@@ -219,25 +281,25 @@ void Item::SetEpisodeCount(int number) {
 }
 
 void Item::SetEpisodeLength(int number) {
-  if (metadata_.extent.size() < 2) {
+  if (metadata_->extent.size() < 2) {
     if (number <= 0)
       return;
-    metadata_.extent.resize(2);
+    EditMetadata().extent.resize(2);
   }
 
-  metadata_.extent.at(1) = number;
+  EditMetadata().extent.at(1) = number;
 }
 
 void Item::SetAiringStatus(int status) {
-  metadata_.status = status;
+  EditMetadata().status = status;
 }
 
 void Item::SetTitle(const std::wstring& title) {
-  metadata_.title = title;
+  EditMetadata().title = title;
 }
 
 void Item::SetEnglishTitle(const std::wstring& title) {
-  for (auto& alt_title : metadata_.alternative) {
+  for (auto& alt_title : EditMetadata().alternative) {
     if (alt_title.type == library::TitleType::LangEnglish) {
       alt_title.value = title;
       return;
@@ -249,11 +311,11 @@ void Item::SetEnglishTitle(const std::wstring& title) {
 
   library::Title new_title(library::TitleType::LangEnglish, title);
 
-  metadata_.alternative.push_back(new_title);
+  EditMetadata().alternative.push_back(new_title);
 }
 
 void Item::SetJapaneseTitle(const std::wstring& title) {
-  for (auto& alt_title : metadata_.alternative) {
+  for (auto& alt_title : EditMetadata().alternative) {
     if (alt_title.type == library::TitleType::LangJapanese) {
       alt_title.value = title;
       return;
@@ -265,14 +327,14 @@ void Item::SetJapaneseTitle(const std::wstring& title) {
 
   library::Title new_title(library::TitleType::LangJapanese, title);
 
-  metadata_.alternative.push_back(new_title);
+  EditMetadata().alternative.push_back(new_title);
 }
 
 void Item::InsertSynonym(const std::wstring& synonym) {
   if (synonym.empty() || synonym == GetTitle() ||
       synonym == GetEnglishTitle() || synonym == GetJapaneseTitle())
     return;
-  metadata_.alternative.push_back(
+  EditMetadata().alternative.push_back(
       library::Title(library::TitleType::Synonym, synonym));
 }
 
@@ -285,15 +347,16 @@ void Item::SetSynonyms(const std::wstring& synonyms) {
 }
 
 void Item::SetSynonyms(const std::vector<std::wstring>& synonyms) {
-  if (synonyms.empty() && metadata_.alternative.empty())
+  if (synonyms.empty() && metadata_->alternative.empty())
     return;
 
+  auto& alternative = EditMetadata().alternative;
   auto iterator = std::remove_if(
-      metadata_.alternative.begin(), metadata_.alternative.end(),
+      alternative.begin(), alternative.end(),
       [](const library::Title& title) {
         return title.type == library::TitleType::Synonym;
       });
-  metadata_.alternative.erase(iterator, metadata_.alternative.end());
+  alternative.erase(iterator, alternative.end());
 
   for (const auto& synonym : synonyms) {
     InsertSynonym(synonym);
@@ -301,13 +364,13 @@ void Item::SetSynonyms(const std::vector<std::wstring>& synonyms) {
 }
 
 void Item::SetDateStart(const Date& date) {
-  if (metadata_.date.size() < 1) {
+  if (metadata_->date.size() < 1) {
     if (!IsValidDate(date))
       return;
-    metadata_.date.resize(1);
+    EditMetadata().date.resize(1);
   }
 
-  metadata_.date.at(0) = date;
+  EditMetadata().date.at(0) = date;
 }
 
 void Item::SetDateStart(const std::wstring& date) {
@@ -315,13 +378,13 @@ void Item::SetDateStart(const std::wstring& date) {
 }
 
 void Item::SetDateEnd(const Date& date) {
-  if (metadata_.date.size() < 2) {
+  if (metadata_->date.size() < 2) {
     if (!IsValidDate(date))
       return;
-    metadata_.date.resize(2);
+    EditMetadata().date.resize(2);
   }
 
-  metadata_.date.at(1) = date;
+  EditMetadata().date.at(1) = date;
 }
 
 void Item::SetDateEnd(const std::wstring& date) {
@@ -329,69 +392,82 @@ void Item::SetDateEnd(const std::wstring& date) {
 }
 
 void Item::SetImageUrl(const std::wstring& url) {
-  if (metadata_.resource.size() < 1) {
+  if (metadata_->resource.size() < 1) {
     if (url.empty())
       return;
-    metadata_.resource.resize(1);
+    EditMetadata().resource.resize(1);
   }
 
-  metadata_.resource.at(0) = url;
+  EditMetadata().resource.at(0) = url;
 }
 
 void Item::SetAgeRating(enum_t rating) {
-  metadata_.audience = rating;
+  EditMetadata().audience = rating;
 }
 
 void Item::SetGenres(const std::wstring& genres) {
-  std::vector<std::wstring> temp;
-  Split(genres, L", ", temp);
-  RemoveEmptyStrings(temp);
-
-  SetGenres(temp);
+  EditMetadata().subject = library::InternStrings(genres, L", ");
 }
 
 void Item::SetGenres(const std::vector<std::wstring>& genres) {
-  metadata_.subject = genres;
+  EditMetadata().subject = library::InternStrings(genres);
+}
+
+void Item::SetGenreSymbols(const std::vector<library::symbol_t>& genres) {
+  EditMetadata().subject = genres;
 }
 
 void Item::SetPopularity(int popularity) {
-  if (metadata_.community.size() < 2) {
+  if (metadata_->community.size() < 2) {
     if (popularity <= 0)
       return;
-    metadata_.community.resize(2);
+    EditMetadata().community.resize(2);
   }
 
-  metadata_.community.at(1) = ToWstr(popularity);
+  EditMetadata().community.at(1) = ToWstr(popularity);
 }
 
 void Item::SetProducers(const std::wstring& producers) {
-  std::vector<std::wstring> temp;
-  Split(producers, L", ", temp);
-  RemoveEmptyStrings(temp);
-
-  SetProducers(temp);
+  EditMetadata().creator = library::InternStrings(producers, L", ");
 }
 
 void Item::SetProducers(const std::vector<std::wstring>& producers) {
-  metadata_.creator = producers;
+  EditMetadata().creator = library::InternStrings(producers);
+}
+
+void Item::SetProducerSymbols(const std::vector<library::symbol_t>& producers) {
+  EditMetadata().creator = producers;
 }
 
 void Item::SetScore(double score) {
-  if (metadata_.community.size() < 1) {
+  if (metadata_->community.size() < 1) {
     if (score <= 0.0)
       return;
-    metadata_.community.resize(1);
+    EditMetadata().community.resize(1);
   }
 
-  metadata_.community.at(0) = score > 0.0 ? ToWstr(score) : L"";
+  EditMetadata().community.at(0) = score > 0.0 ? ToWstr(score) : L"";
 }
 
 void Item::SetSynopsis(const std::wstring& synopsis) {
-  metadata_.description = synopsis;
+  lazy_synopsis_.reset();
+  EditMetadata().description = synopsis;
+}
+
+void Item::SetSynopsis(const std::shared_ptr<const DatabaseSnapshot>& snapshot,
+                       uint32_t index) {
+  EditMetadata().description.clear();
+
+  // Items without a synopsis do not need to keep the snapshot open
+  if (snapshot->GetStringLength(index)) {
+    lazy_synopsis_ = std::make_shared<LazySynopsis>(snapshot, index);
+  } else {
+    lazy_synopsis_.reset();
+  }
 }
 
 void Item::SetLastModified(time_t modified) {
-  metadata_.modified = modified;
+  EditMetadata().modified = modified;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -724,6 +800,21 @@ bool Item::UserSynonymsAvailable() const {
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
+library::Metadata& Item::EditMetadata() {
+  // Metadata that no other item refers to can be modified in place
+  if (metadata_.use_count() > 1)
+    metadata_ = std::make_shared<library::Metadata>(*metadata_);
+  return *metadata_;
+}
+
+Item Item::CopyMetadata() const {
+  // Series information and the synopsis are shared with the copy until either
+  // of them is modified, so copying is cheap
+  Item item(metadata_);
+  item.lazy_synopsis_ = lazy_synopsis_;
+  return item;
+}
+
 void Item::AddtoUserList() {
   if (!my_info_.get()) {
     my_info_.reset(new MyInformation);
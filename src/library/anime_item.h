@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
@@ -29,6 +30,7 @@ enum class QueueSearch;
 
 namespace anime {
 class Database;
+class DatabaseSnapshot;
 class Episode;
 class Item;
 }
@@ -61,9 +63,14 @@ public:
   const Date& GetDateEnd() const;
   const std::wstring& GetImageUrl() const;
   enum_t GetAgeRating() const;
-  const std::vector<std::wstring>& GetGenres() const;
+  std::vector<std::wstring> GetGenres() const;
+  const std::vector<library::symbol_t>& GetGenreSymbols() const;
+  bool HasGenre(library::symbol_t genre) const;
+  bool HasGenres() const;
   int GetPopularity() const;
-  const std::vector<std::wstring>& GetProducers() const;
+  std::vector<std::wstring> GetProducers() const;
+  const std::vector<library::symbol_t>& GetProducerSymbols() const;
+  bool HasProducers() const;
   double GetScore() const;
   const std::wstring& GetSynopsis() const;
   const time_t GetLastModified() const;
@@ -89,11 +96,15 @@ public:
   void SetAgeRating(enum_t rating);
   void SetGenres(const std::wstring& genres);
   void SetGenres(const std::vector<std::wstring>& genres);
+  void SetGenreSymbols(const std::vector<library::symbol_t>& genres);
   void SetPopularity(int popularity);
   void SetProducers(const std::wstring& producers);
   void SetProducers(const std::vector<std::wstring>& producers);
+  void SetProducerSymbols(const std::vector<library::symbol_t>& producers);
   void SetScore(double score);
   void SetSynopsis(const std::wstring& synopsis);
+  void SetSynopsis(const std::shared_ptr<const DatabaseSnapshot>& snapshot,
+                   uint32_t index);
   void SetLastModified(time_t modified);
 
   //////////////////////////////////////////////////////////////////////////////
@@ -153,17 +164,29 @@ public:
 
   //////////////////////////////////////////////////////////////////////////////
 
+  // Copy that only has series information, which can be read on another thread
+  Item CopyMetadata() const;
+
   // A database item may not be in user's list.
   void AddtoUserList();
   bool IsInList() const;
   void RemoveFromUserList();
 
 private:
+  explicit Item(const std::shared_ptr<library::Metadata>& metadata);
+
   // Helper function
   HistoryItem* SearchHistory(QueueSearch search_mode) const;
 
-  // Series information, stored in db\anime.xml
-  library::Metadata metadata_;
+  // Series information, stored in db\anime.xml. Copies of the item share it
+  // until either of them modifies it.
+  library::Metadata& EditMetadata();
+  std::shared_ptr<library::Metadata> metadata_;
+
+  // Synopsis that is decoded from the database snapshot on first access.
+  // Copies of the item share it, and it may be read from any thread.
+  class LazySynopsis;
+  std::shared_ptr<LazySynopsis> lazy_synopsis_;
 
   // User information, stored in user\<username>\anime.xml - some items are not
   // in user's list, thus this member is not valid for every item.
@@ -0,0 +1,268 @@
+/*
+** Taiga
+** Copyright (C) 2010-2018, Eren Okka
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <ctime>
+
+#include "base/binary.h"
+#include "base/file.h"
+#include "base/log.h"
+#include "base/string.h"
+#include "library/anime_db.h"
+#include "sync/sync.h"
+#include "taiga/path.h"
+
+namespace anime {
+
+// Changes to the library are appended to a journal, which is merged into the
+// list file once it gets too large or too old. Each entry holds the complete
+// library data of an item, so that replaying an entry more than once does no
+// harm. Entries are numbered, so that a list file that was saved in the
+// background knows which entries it already contains.
+constexpr uint32_t kListJournalMagic = 0x4C4E4A4C;  // "LJNL"
+constexpr uint32_t kListJournalVersion = 1;
+constexpr size_t kListJournalMaxSize = 64 * 1024;   // 64 KiB
+constexpr time_t kListJournalMaxAge = 10 * 60;      // 10 minutes
+
+static std::string EncodeListJournalEntry(const Item& item,
+                                          uint64_t sequence) {
+  base::BinaryWriter payload;
+  payload.WriteUInt64(sequence);
+  payload.WriteInt32(item.GetId());
+  payload.WriteInt32(item.IsInList());
+
+  // Same values as in SaveList
+  if (item.IsInList()) {
+    payload.WriteString(item.GetMyId());
+    payload.WriteInt32(item.GetMyLastWatchedEpisode(false));
+    payload.WriteString(std::wstring(item.GetMyDateStart()));
+    payload.WriteString(std::wstring(item.GetMyDateEnd()));
+    payload.WriteInt32(item.GetMyScore(false));
+    payload.WriteInt32(item.GetMyStatus(false));
+    payload.WriteInt32(item.GetMyRewatchedTimes());
+    payload.WriteInt32(item.GetMyRewatching(false));
+    payload.WriteInt32(item.GetMyRewatchingEp());
+    payload.WriteString(item.GetMyTags(false));
+    payload.WriteString(item.GetMyNotes(false));
+    payload.WriteString(item.GetMyLastUpdated());
+  }
+
+  base::Checksum checksum;
+  checksum.Update(payload.data().data(), payload.data().size());
+
+  base::BinaryWriter writer;
+  writer.WriteUInt32(static_cast<uint32_t>(payload.data().size()));
+  writer.WriteUInt64(checksum.value());
+  writer.WriteBytes(payload.data().data(), payload.data().size());
+  return writer.data();
+}
+
+static bool DecodeListJournalEntry(base::BinaryReader& reader, Item& item,
+                                   uint64_t& sequence) {
+  int32_t id = 0;
+  int32_t in_list = 0;
+  if (!reader.ReadUInt64(sequence) || !reader.ReadInt32(id) ||
+      !reader.ReadInt32(in_list))
+    return false;
+
+  item.SetId(ToWstr(id), sync::kTaiga);
+  item.SetSource(sync::kTaiga);
+
+  if (!in_list)
+    return !reader.remaining();
+
+  std::wstring library_id, date_start, date_end, tags, notes, last_updated;
+  int32_t progress = 0, score = 0, status = 0;
+  int32_t rewatched_times = 0, rewatching = 0, rewatching_ep = 0;
+
+  if (!reader.ReadString(library_id) || !reader.ReadInt32(progress) ||
+      !reader.ReadString(date_start) || !reader.ReadString(date_end) ||
+      !reader.ReadInt32(score) || !reader.ReadInt32(status) ||
+      !reader.ReadInt32(rewatched_times) || !reader.ReadInt32(rewatching) ||
+      !reader.ReadInt32(rewatching_ep) || !reader.ReadString(tags) ||
+      !reader.ReadString(notes) || !reader.ReadString(last_updated) ||
+      reader.remaining())
+    return false;
+
+  item.AddtoUserList();
+  item.SetMyId(library_id);
+  item.SetMyLastWatchedEpisode(progress);
+  item.SetMyDateStart(date_start);
+  item.SetMyDateEnd(date_end);
+  item.SetMyScore(score);
+  item.SetMyStatus(status);
+  item.SetMyRewatchedTimes(rewatched_times);
+  item.SetMyRewatching(rewatching);
+  item.SetMyRewatchingEp(rewatching_ep);
+  item.SetMyTags(tags);
+  item.SetMyNotes(notes);
+  item.SetMyLastUpdated(last_updated);
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Database::SaveListEntry(int anime_id) {
+  auto anime_item = FindItem(anime_id, false);
+  if (!anime_item)
+    return false;
+
+  bool compact = false;
+  {
+    std::lock_guard<std::mutex> lock(list_journal_mutex_);
+
+    if (!list_journal_size_)
+      list_journal_path_ = taiga::GetPath(taiga::Path::UserLibraryJournal);
+
+    std::string data;
+    if (!list_journal_size_) {
+      base::BinaryWriter writer;
+      writer.WriteUInt32(kListJournalMagic);
+      writer.WriteUInt32(kListJournalVersion);
+      data = writer.data();
+    }
+    data += EncodeListJournalEntry(*anime_item, list_journal_sequence_ + 1);
+
+    if (AppendToFile(data, list_journal_path_)) {
+      ++list_journal_sequence_;
+      if (!list_journal_size_)
+        list_journal_time_ = time(nullptr);
+      list_journal_size_ += data.size();
+      compact = list_journal_size_ >= kListJournalMaxSize;
+    } else {
+      LOGW(L"Could not append to list journal: {}", list_journal_path_);
+      compact = true;
+    }
+  }
+
+  if (compact)
+    return SaveList();
+
+  return true;
+}
+
+bool Database::CompactListJournal(bool force) {
+  {
+    std::lock_guard<std::mutex> lock(list_journal_mutex_);
+
+    if (!list_journal_size_)
+      return true;
+
+    if (!force && time(nullptr) - list_journal_time_ < kListJournalMaxAge)
+      return true;
+  }
+
+  // Deletes the journal once the list is saved
+  return SaveList();
+}
+
+bool Database::ReadListJournal(uint64_t saved_sequence) {
+  std::lock_guard<std::mutex> lock(list_journal_mutex_);
+
+  const auto path = taiga::GetPath(taiga::Path::UserLibraryJournal);
+
+  list_journal_path_ = path;
+  list_journal_sequence_ = saved_sequence;
+  list_journal_size_ = 0;
+  list_journal_time_ = 0;
+
+  std::string data;
+  if (!ReadFromFile(path, data) || data.empty())
+    return true;
+
+  // The journal has to be compacted in any case, as long as it exists
+  list_journal_size_ = data.size();
+  list_journal_time_ = time(nullptr);
+
+  base::BinaryReader reader(data.data(), data.size());
+
+  uint32_t magic = 0;
+  uint32_t version = 0;
+  if (!reader.ReadUInt32(magic) || magic != kListJournalMagic ||
+      !reader.ReadUInt32(version) || version != kListJournalVersion) {
+    LOGW(L"Invalid list journal: {}", path);
+    return false;
+  }
+
+  size_t count = 0;
+
+  while (reader.remaining()) {
+    uint32_t size = 0;
+    uint64_t checksum = 0;
+    std::string payload;
+    if (!reader.ReadUInt32(size) || !reader.ReadUInt64(checksum) ||
+        size > reader.remaining()) {
+      LOGW(L"List journal ends with an incomplete entry: {}", path);
+      return false;
+    }
+    payload.resize(size);
+    reader.ReadBytes(&payload[0], size);
+
+    base::Checksum payload_checksum;
+    payload_checksum.Update(payload.data(), payload.size());
+
+    Item anime_item;
+    uint64_t sequence = 0;
+    base::BinaryReader entry_reader(payload.data(), payload.size());
+    if (payload_checksum.value() != checksum ||
+        !DecodeListJournalEntry(entry_reader, anime_item, sequence)) {
+      LOGW(L"List journal has an invalid entry: {}", path);
+      return false;
+    }
+
+    list_journal_sequence_ = std::max(list_journal_sequence_, sequence);
+
+    // Already in the list file
+    if (sequence <= saved_sequence)
+      continue;
+
+    if (anime_item.IsInList()) {
+      UpdateItem(anime_item);
+    } else {
+      auto item = FindItem(anime_item.GetId(), false);
+      if (item && item->IsInList())
+        item->RemoveFromUserList();
+    }
+
+    ++count;
+  }
+
+  LOGD(L"Replayed {} list journal entries", count);
+  return true;
+}
+
+void Database::OnListSaved(const std::wstring& journal_path,
+                           uint64_t sequence) {
+  std::lock_guard<std::mutex> lock(list_journal_mutex_);
+
+  // Entries that were appended in the meantime are not in the list yet
+  if (journal_path == list_journal_path_ &&
+      sequence == list_journal_sequence_)
+    DeleteListJournal();
+}
+
+void Database::DeleteListJournal() {
+  if (!list_journal_path_.empty())
+    ::DeleteFile(GetExtendedLengthPath(list_journal_path_).c_str());
+
+  list_journal_size_ = 0;
+  list_journal_time_ = 0;
+}
+
+}  // namespace anime
@@ -0,0 +1,306 @@
+/*
+** Taiga
+** Copyright (C) 2010-2018, Eren Okka
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <memory>
+
+#include "base/binary.h"
+#include "base/file.h"
+#include "base/log.h"
+#include "base/string.h"
+#include "library/anime_db.h"
+#include "library/anime_snapshot.h"
+#include "sync/sync.h"
+#include "taiga/path.h"
+#include "taiga/taiga.h"
+
+namespace anime {
+
+constexpr uint32_t kSnapshotMagic = 0x53424441;  // "ADBS"
+constexpr uint32_t kSnapshotVersion = 1;
+
+// The layout of the file depends on these
+static_assert(sizeof(DatabaseSnapshot::Header) == 48, "");
+static_assert(sizeof(DatabaseSnapshot::Record) == 112, "");
+static_assert(sizeof(DatabaseSnapshot::String) == 8, "");
+
+bool DatabaseSnapshot::Open(const std::wstring& path, uint64_t xml_size,
+                            uint64_t xml_write_time,
+                            const std::wstring& app_version) {
+  auto fail = [this]() {
+    file_.Close();
+    header_ = nullptr;
+    records_ = nullptr;
+    strings_ = nullptr;
+    chars_ = nullptr;
+    return false;
+  };
+
+  if (!file_.Open(path))
+    return false;
+
+  if (file_.size() < sizeof(Header))
+    return fail();
+
+  header_ = reinterpret_cast<const Header*>(file_.data());
+
+  if (header_->magic != kSnapshotMagic ||
+      header_->version != kSnapshotVersion ||
+      header_->xml_size != xml_size ||
+      header_->xml_write_time != xml_write_time) {
+    LOGD(L"Anime database snapshot is out of date");
+    return fail();
+  }
+
+  const uint64_t size = sizeof(Header) +
+      static_cast<uint64_t>(header_->record_count) * sizeof(Record) +
+      static_cast<uint64_t>(header_->string_count) * sizeof(String) +
+      static_cast<uint64_t>(header_->char_count) * sizeof(wchar_t);
+  if (file_.size() != size) {
+    LOGW(L"Anime database snapshot is corrupted: {}", path);
+    return fail();
+  }
+
+  records_ = reinterpret_cast<const Record*>(file_.data() + sizeof(Header));
+  strings_ = reinterpret_cast<const String*>(
+      records_ + header_->record_count);
+  chars_ = reinterpret_cast<const wchar_t*>(
+      strings_ + header_->string_count);
+
+  // References are checked once here, so that decoding needs no checks
+  auto is_valid_list = [this](uint64_t index, uint64_t count) {
+    return index + count <= header_->string_count;
+  };
+  auto is_valid = [&is_valid_list](uint32_t index) {
+    return is_valid_list(index, 1);
+  };
+
+  bool valid = is_valid(header_->app_version);
+  for (uint32_t i = 0; valid && i < header_->string_count; ++i) {
+    const auto& str = strings_[i];
+    valid = static_cast<uint64_t>(str.offset) + str.length <=
+            header_->char_count;
+  }
+  for (uint32_t i = 0; valid && i < header_->record_count; ++i) {
+    const auto& record = records_[i];
+    valid = is_valid_list(record.ids, header_->service_count) &&
+            is_valid(record.slug) && is_valid(record.title) &&
+            is_valid(record.english_title) &&
+            is_valid(record.japanese_title) &&
+            is_valid(record.image_url) && is_valid(record.synopsis) &&
+            is_valid_list(record.synonyms[0], record.synonyms[1]) &&
+            is_valid_list(record.genres[0], record.genres[1]) &&
+            is_valid_list(record.producers[0], record.producers[1]);
+  }
+  if (!valid) {
+    LOGW(L"Anime database snapshot is corrupted: {}", path);
+    return fail();
+  }
+
+  // Data may have to be converted after an update, which only the XML
+  // document is read for
+  if (GetString(header_->app_version) != app_version) {
+    LOGD(L"Anime database snapshot is from another version");
+    return fail();
+  }
+
+  return true;
+}
+
+size_t DatabaseSnapshot::record_count() const {
+  return header_ ? header_->record_count : 0;
+}
+
+const DatabaseSnapshot::Record& DatabaseSnapshot::record(size_t index) const {
+  return records_[index];
+}
+
+uint32_t DatabaseSnapshot::service_count() const {
+  return header_ ? header_->service_count : 0;
+}
+
+std::wstring DatabaseSnapshot::GetString(uint32_t index) const {
+  const auto& str = strings_[index];
+  return std::wstring(chars_ + str.offset, str.length);
+}
+
+uint32_t DatabaseSnapshot::GetStringLength(uint32_t index) const {
+  return strings_[index].length;
+}
+
+std::vector<std::wstring> DatabaseSnapshot::GetStrings(
+    const uint32_t (&list)[2]) const {
+  std::vector<std::wstring> strings;
+  strings.reserve(list[1]);
+  for (uint32_t i = 0; i < list[1]; ++i)
+    strings.push_back(GetString(list[0] + i));
+  return strings;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Database::ReadSnapshot() {
+  const auto xml_path = taiga::GetPath(taiga::Path::DatabaseAnime);
+  const auto path = taiga::GetPath(taiga::Path::DatabaseAnimeSnapshot);
+
+  auto snapshot = std::make_shared<DatabaseSnapshot>();
+  if (!snapshot->Open(path, GetFileSize(xml_path),
+                      GetFileLastWriteTime(xml_path),
+                      StrToWstr(Taiga.version.to_string())))
+    return false;
+
+  if (snapshot->service_count() != sync::kLastService + 1) {
+    LOGD(L"Anime database snapshot has a different number of services");
+    return false;
+  }
+
+  auto read_date = [](const uint16_t (&date)[3]) {
+    return Date(date[0], date[1], date[2]);
+  };
+
+  for (size_t i = 0; i < snapshot->record_count(); ++i) {
+    const auto& record = snapshot->record(i);
+
+    int id = ToInt(snapshot->GetString(record.ids + sync::kTaiga));
+    Item& item = items[id];  // Creates the item if it doesn't exist
+
+    for (enum_t service = 0; service <= sync::kLastService; ++service) {
+      const auto service_id = snapshot->GetString(record.ids + service);
+      if (!service_id.empty())
+        item.SetId(service_id, service);
+    }
+
+    item.SetSource(record.source);
+    item.SetTitle(snapshot->GetString(record.title));
+    item.SetType(record.type);
+    item.SetAiringStatus(record.status);
+    item.SetAgeRating(record.age_rating);
+    item.SetGenres(snapshot->GetStrings(record.genres));
+    item.SetProducers(snapshot->GetStrings(record.producers));
+    item.SetSynopsis(snapshot, record.synopsis);
+    item.SetLastModified(static_cast<time_t>(record.modified));
+
+    // Same order as in ReadDatabaseNode, which results in less reallocations
+    item.SetEnglishTitle(snapshot->GetString(record.english_title));
+    item.SetJapaneseTitle(snapshot->GetString(record.japanese_title));
+    for (const auto& synonym : snapshot->GetStrings(record.synonyms))
+      item.InsertSynonym(synonym);
+    item.SetPopularity(record.popularity);
+    item.SetScore(record.score);
+    item.SetDateEnd(read_date(record.date_end));
+    item.SetDateStart(read_date(record.date_start));
+    item.SetEpisodeLength(record.episode_length);
+    item.SetEpisodeCount(record.episode_count);
+    item.SetSlug(snapshot->GetString(record.slug));
+    item.SetImageUrl(snapshot->GetString(record.image_url));
+  }
+
+  return true;
+}
+
+bool Database::WriteSnapshot(const std::vector<Item>& items) {
+  const auto xml_path = taiga::GetPath(taiga::Path::DatabaseAnime);
+
+  DatabaseSnapshot::Header header = {};
+  std::vector<DatabaseSnapshot::Record> records;
+  std::vector<DatabaseSnapshot::String> strings;
+  std::wstring chars;
+
+  auto add_string = [&strings, &chars](const std::wstring& str) {
+    strings.push_back({static_cast<uint32_t>(chars.size()),
+                       static_cast<uint32_t>(str.size())});
+    chars.append(str);
+    return static_cast<uint32_t>(strings.size() - 1);
+  };
+  auto add_strings = [&strings, &add_string](
+      const std::vector<std::wstring>& list, uint32_t (&ref)[2]) {
+    ref[0] = static_cast<uint32_t>(strings.size());
+    ref[1] = static_cast<uint32_t>(list.size());
+    for (const auto& str : list)
+      add_string(str);
+  };
+  auto write_date = [](const Date& date, uint16_t (&ref)[3]) {
+    // Invalid dates are not written to the XML document either
+    if (date) {
+      ref[0] = date.year();
+      ref[1] = date.month();
+      ref[2] = date.day();
+    }
+  };
+
+  header.magic = kSnapshotMagic;
+  header.version = kSnapshotVersion;
+  header.app_version = add_string(StrToWstr(Taiga.version.to_string()));
+  header.service_count = sync::kLastService + 1;
+
+  records.reserve(items.size());
+
+  for (const auto& item : items) {
+    DatabaseSnapshot::Record record = {};
+    record.modified = item.GetLastModified();
+    record.score = item.GetScore();
+    record.source = item.GetSource();
+    record.type = item.GetType();
+    record.status = item.GetAiringStatus();
+    record.age_rating = item.GetAgeRating();
+    record.episode_count = item.GetEpisodeCount();
+    record.episode_length = item.GetEpisodeLength();
+    record.popularity = item.GetPopularity();
+    write_date(item.GetDateStart(), record.date_start);
+    write_date(item.GetDateEnd(), record.date_end);
+
+    record.ids = static_cast<uint32_t>(strings.size());
+    for (enum_t service = 0; service <= sync::kLastService; ++service)
+      add_string(item.GetId(service));
+
+    record.slug = add_string(item.GetSlug());
+    record.title = add_string(item.GetTitle());
+    record.english_title = add_string(item.GetEnglishTitle());
+    record.japanese_title = add_string(item.GetJapaneseTitle());
+    record.image_url = add_string(item.GetImageUrl());
+    record.synopsis = add_string(item.GetSynopsis());
+    add_strings(item.GetSynonyms(), record.synonyms);
+    add_strings(item.GetGenres(), record.genres);
+    add_strings(item.GetProducers(), record.producers);
+
+    records.push_back(record);
+  }
+
+  header.record_count = static_cast<uint32_t>(records.size());
+  header.string_count = static_cast<uint32_t>(strings.size());
+  header.char_count = static_cast<uint32_t>(chars.size());
+
+  // The snapshot is only valid for the document it was written along with
+  header.xml_size = GetFileSize(xml_path);
+  header.xml_write_time = GetFileLastWriteTime(xml_path);
+
+  base::BinaryWriter writer;
+  writer.WriteBytes(&header, sizeof(header));
+  writer.WriteBytes(records.data(), records.size() * sizeof(records[0]));
+  writer.WriteBytes(strings.data(), strings.size() * sizeof(strings[0]));
+  writer.WriteBytes(chars.data(), chars.size() * sizeof(wchar_t));
+
+  const auto path = taiga::GetPath(taiga::Path::DatabaseAnimeSnapshot);
+  if (!SaveToFile(writer.data(), path)) {
+    LOGW(L"Could not save anime database snapshot: {}", path);
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace anime
@@ -0,0 +1,101 @@
+/*
+** Taiga
+** Copyright (C) 2010-2018, Eren Okka
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "base/file.h"
+
+namespace anime {
+
+// Binary copy of db\anime.xml that is mapped into memory at startup. Records
+// have a fixed size and are read in place. Strings are stored in a shared pool
+// and are only decoded when needed.
+class DatabaseSnapshot {
+public:
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t xml_size;
+    uint64_t xml_write_time;
+    uint32_t app_version;  // string
+    uint32_t service_count;
+    uint32_t record_count;
+    uint32_t string_count;
+    uint32_t char_count;
+    uint32_t reserved;
+  };
+
+  // Each string field is an index to the string table, and each list is the
+  // index of its first string followed by the number of strings.
+  struct Record {
+    int64_t modified;
+    double score;
+    int32_t source;
+    int32_t type;
+    int32_t status;
+    int32_t age_rating;
+    int32_t episode_count;
+    int32_t episode_length;
+    int32_t popularity;
+    uint16_t date_start[3];
+    uint16_t date_end[3];
+    uint32_t ids;  // one for each service
+    uint32_t slug;
+    uint32_t title;
+    uint32_t english_title;
+    uint32_t japanese_title;
+    uint32_t image_url;
+    uint32_t synopsis;
+    uint32_t synonyms[2];
+    uint32_t genres[2];
+    uint32_t producers[2];
+  };
+
+  struct String {
+    uint32_t offset;
+    uint32_t length;
+  };
+
+  DatabaseSnapshot() = default;
+  DatabaseSnapshot(const DatabaseSnapshot&) = delete;
+  DatabaseSnapshot& operator=(const DatabaseSnapshot&) = delete;
+
+  bool Open(const std::wstring& path, uint64_t xml_size,
+            uint64_t xml_write_time, const std::wstring& app_version);
+
+  size_t record_count() const;
+  const Record& record(size_t index) const;
+  uint32_t service_count() const;
+
+  std::wstring GetString(uint32_t index) const;
+  uint32_t GetStringLength(uint32_t index) const;
+  std::vector<std::wstring> GetStrings(const uint32_t (&list)[2]) const;
+
+private:
+  FileMapping file_;
+  const Header* header_ = nullptr;
+  const Record* records_ = nullptr;
+  const String* strings_ = nullptr;
+  const wchar_t* chars_ = nullptr;
+};
+
+}  // namespace anime
@@ -0,0 +1,280 @@
+/*
+** Taiga
+** Copyright (C) 2010-2018, Eren Okka
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <tuple>
+
+#include "library/anime_store.h"
+
+namespace anime {
+
+ItemStore::~ItemStore() {
+  clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ItemStore::iterator ItemStore::begin() {
+  SortOrder();
+  return iterator::Forward(this, 0);
+}
+
+ItemStore::const_iterator ItemStore::begin() const {
+  SortOrder();
+  return const_iterator::Forward(this, 0);
+}
+
+ItemStore::iterator ItemStore::end() {
+  return iterator(this, npos, npos);
+}
+
+ItemStore::const_iterator ItemStore::end() const {
+  return const_iterator(this, npos, npos);
+}
+
+ItemStore::reverse_iterator ItemStore::rbegin() {
+  return reverse_iterator(end());
+}
+
+ItemStore::const_reverse_iterator ItemStore::rbegin() const {
+  return const_reverse_iterator(end());
+}
+
+ItemStore::reverse_iterator ItemStore::rend() {
+  return reverse_iterator(begin());
+}
+
+ItemStore::const_reverse_iterator ItemStore::rend() const {
+  return const_reverse_iterator(begin());
+}
+
+bool ItemStore::empty() const {
+  return size_ == 0;
+}
+
+size_t ItemStore::size() const {
+  return size_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ItemStore::iterator ItemStore::find(int id) {
+  const auto slot = FindSlot(id);
+  return slot != npos ? iterator(this, slot, npos) : end();
+}
+
+ItemStore::const_iterator ItemStore::find(int id) const {
+  const auto slot = FindSlot(id);
+  return slot != npos ? const_iterator(this, slot, npos) : end();
+}
+
+Item& ItemStore::operator[](int id) {
+  auto slot = FindSlot(id);
+  if (slot == npos)
+    slot = InsertSlot(id);
+  return value(slot).second;
+}
+
+size_t ItemStore::erase(int id) {
+  const auto slot = FindSlot(id);
+  if (slot == npos)
+    return 0;
+
+  EraseSlot(slot);
+  return 1;
+}
+
+ItemStore::iterator ItemStore::erase(const_iterator it) {
+  iterator next(this, it.slot_, it.position_);
+  ++next;
+  EraseSlot(it.slot_);
+  return next;
+}
+
+void ItemStore::clear() {
+  for (size_t slot = 0; slot < used_.size(); ++slot)
+    if (used_[slot])
+      value(slot).~value_type();
+
+  chunks_.clear();
+  ids_.clear();
+  used_.clear();
+  free_slots_.clear();
+  buckets_.clear();
+  order_.clear();
+  order_changed_ = false;
+  size_ = 0;
+}
+
+void ItemStore::reserve(size_t count) {
+  while (chunks_.size() * kChunkSize < count)
+    chunks_.push_back(std::make_unique<Chunk>());
+  ids_.reserve(count);
+  used_.reserve(count);
+  order_.reserve(count);
+
+  if (buckets_.size() < count * 2) {
+    size_t bucket_count = 16;
+    while (bucket_count < count * 2)
+      bucket_count *= 2;
+    Rehash(bucket_count);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+size_t ItemStore::FindSlot(int id) const {
+  if (buckets_.empty())
+    return npos;
+
+  const size_t mask = buckets_.size() - 1;
+  for (size_t bucket = GetBucket(id); ; bucket = (bucket + 1) & mask) {
+    const auto entry = buckets_[bucket];
+    if (!entry)
+      return npos;
+    if (ids_[entry - 1] == id)
+      return entry - 1;
+  }
+}
+
+size_t ItemStore::InsertSlot(int id) {
+  // Keep the table at most half full
+  if ((size_ + 1) * 2 > buckets_.size())
+    Rehash(std::max<size_t>(16, buckets_.size() * 2));
+
+  size_t slot = 0;
+  if (!free_slots_.empty()) {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+    ids_[slot] = id;
+    used_[slot] = true;
+  } else {
+    slot = ids_.size();
+    if (slot == chunks_.size() * kChunkSize)
+      chunks_.push_back(std::make_unique<Chunk>());
+    ids_.push_back(id);
+    used_.push_back(true);
+    order_.push_back(slot);
+  }
+
+  new (&chunks_[slot / kChunkSize]->slots[slot % kChunkSize]) value_type(
+      std::piecewise_construct, std::forward_as_tuple(id),
+      std::forward_as_tuple());
+  ++size_;
+
+  const size_t mask = buckets_.size() - 1;
+  size_t bucket = GetBucket(id);
+  while (buckets_[bucket])
+    bucket = (bucket + 1) & mask;
+  buckets_[bucket] = slot + 1;
+
+  // Appending a greater ID keeps the order sorted
+  if (order_changed_ || order_.size() < 2 ||
+      order_[order_.size() - 1] != slot ||
+      ids_[order_[order_.size() - 2]] >= id) {
+    order_changed_ = true;
+  }
+
+  return slot;
+}
+
+void ItemStore::EraseSlot(size_t slot) {
+  const size_t mask = buckets_.size() - 1;
+
+  size_t bucket = GetBucket(ids_[slot]);
+  while (buckets_[bucket] != slot + 1)
+    bucket = (bucket + 1) & mask;
+
+  // Shift back the entries that would no longer be reachable, instead of
+  // leaving a tombstone
+  for (size_t next = (bucket + 1) & mask; buckets_[next];
+       next = (next + 1) & mask) {
+    const auto home = GetBucket(ids_[buckets_[next] - 1]);
+    const bool reachable = bucket <= next ?
+        (bucket < home && home <= next) : (bucket < home || home <= next);
+    if (!reachable) {
+      buckets_[bucket] = buckets_[next];
+      bucket = next;
+    }
+  }
+  buckets_[bucket] = 0;
+
+  value(slot).~value_type();
+  used_[slot] = false;
+  free_slots_.push_back(slot);
+  --size_;
+}
+
+size_t ItemStore::GetBucket(int id) const {
+  // Fibonacci hashing spreads consecutive IDs across the table
+  const auto hash = static_cast<uint32_t>(id) * 2654435769u;
+  return (hash ^ (hash >> 16)) & (buckets_.size() - 1);
+}
+
+void ItemStore::Rehash(size_t bucket_count) {
+  buckets_.assign(bucket_count, 0);
+
+  const size_t mask = bucket_count - 1;
+  for (size_t slot = 0; slot < used_.size(); ++slot) {
+    if (!used_[slot])
+      continue;
+    size_t bucket = GetBucket(ids_[slot]);
+    while (buckets_[bucket])
+      bucket = (bucket + 1) & mask;
+    buckets_[bucket] = slot + 1;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ItemStore::SortOrder() const {
+  if (!order_changed_)
+    return;
+
+  order_.clear();
+  for (size_t slot = 0; slot < used_.size(); ++slot)
+    if (used_[slot])
+      order_.push_back(slot);
+
+  std::sort(order_.begin(), order_.end(),
+            [this](size_t a, size_t b) { return ids_[a] < ids_[b]; });
+
+  order_changed_ = false;
+}
+
+size_t ItemStore::GetPosition(size_t slot, size_t position) const {
+  if (position != npos)
+    return position;
+
+  SortOrder();
+
+  if (slot == npos)
+    return order_.size();
+
+  // Erased slots are still in place, so the order is sorted by their IDs too
+  auto it = std::lower_bound(
+      order_.begin(), order_.end(), ids_[slot],
+      [this](size_t a, int id) { return ids_[a] < id; });
+  while (*it != slot)
+    ++it;
+  return it - order_.begin();
+}
+
+}  // namespace anime
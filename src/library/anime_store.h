@@ -0,0 +1,207 @@
+/*
+** Taiga
+** Copyright (C) 2010-2018, Eren Okka
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "library/anime_item.h"
+
+namespace anime {
+
+// Stores items in fixed-size chunks of contiguous slots, which are reused after
+// an item is erased. References to an item stay valid until it is erased. An
+// open addressing table maps IDs to slots.
+//
+// Like std::map, iteration is in ascending order of IDs. Items that are loaded
+// in that order also lie in that order in memory, so a full pass is a linear
+// sweep. Inserting an item invalidates iterators, erasing one does not (except
+// for iterators to the erased item).
+class ItemStore {
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+public:
+  using key_type = int;
+  using mapped_type = Item;
+  using value_type = std::pair<const int, Item>;
+  using size_type = size_t;
+
+  template <typename Store, typename Value>
+  class basic_iterator {
+  public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = ItemStore::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Value*;
+    using reference = Value&;
+
+    basic_iterator() = default;
+    basic_iterator(Store* store, size_t slot, size_t position)
+        : store_(store), slot_(slot), position_(position) {}
+    template <typename OtherStore, typename OtherValue>
+    basic_iterator(const basic_iterator<OtherStore, OtherValue>& other)
+        : store_(other.store_), slot_(other.slot_),
+          position_(other.position_) {}
+
+    reference operator*() const { return store_->value(slot_); }
+    pointer operator->() const { return &store_->value(slot_); }
+
+    basic_iterator& operator++() {
+      const auto position = store_->GetPosition(slot_, position_);
+      return *this = Forward(store_, position + 1);
+    }
+    basic_iterator operator++(int) {
+      auto it = *this;
+      ++*this;
+      return it;
+    }
+    basic_iterator& operator--() {
+      const auto position = store_->GetPosition(slot_, position_);
+      return *this = Backward(store_, position);
+    }
+    basic_iterator operator--(int) {
+      auto it = *this;
+      --*this;
+      return it;
+    }
+
+    friend bool operator==(const basic_iterator& lhs,
+                           const basic_iterator& rhs) {
+      return lhs.slot_ == rhs.slot_;
+    }
+    friend bool operator!=(const basic_iterator& lhs,
+                           const basic_iterator& rhs) {
+      return lhs.slot_ != rhs.slot_;
+    }
+
+  private:
+    template <typename, typename>
+    friend class basic_iterator;
+    friend class ItemStore;
+
+    // First item at or after the position
+    static basic_iterator Forward(Store* store, size_t position) {
+      for (; position < store->order_.size(); ++position) {
+        const auto slot = store->order_[position];
+        if (store->used_[slot])
+          return basic_iterator(store, slot, position);
+      }
+      return basic_iterator(store, npos, npos);
+    }
+
+    // Last item before the position
+    static basic_iterator Backward(Store* store, size_t position) {
+      while (position-- > 0) {
+        const auto slot = store->order_[position];
+        if (store->used_[slot])
+          return basic_iterator(store, slot, position);
+      }
+      return basic_iterator(store, npos, npos);
+    }
+
+    Store* store_ = nullptr;
+    size_t slot_ = ItemStore::npos;
+    size_t position_ = ItemStore::npos;
+  };
+
+  using iterator = basic_iterator<ItemStore, value_type>;
+  using const_iterator = basic_iterator<const ItemStore, const value_type>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  ItemStore() = default;
+  ItemStore(const ItemStore&) = delete;
+  ItemStore& operator=(const ItemStore&) = delete;
+  ~ItemStore();
+
+  iterator begin();
+  const_iterator begin() const;
+  iterator end();
+  const_iterator end() const;
+  reverse_iterator rbegin();
+  const_reverse_iterator rbegin() const;
+  reverse_iterator rend();
+  const_reverse_iterator rend() const;
+
+  bool empty() const;
+  size_t size() const;
+
+  iterator find(int id);
+  const_iterator find(int id) const;
+  Item& operator[](int id);
+
+  size_t erase(int id);
+  iterator erase(const_iterator it);
+  void clear();
+  void reserve(size_t count);
+
+private:
+  static constexpr size_t kChunkSize = 256;
+
+  using slot_t = std::aligned_storage_t<sizeof(value_type),
+                                        alignof(value_type)>;
+  struct Chunk {
+    slot_t slots[kChunkSize];
+  };
+
+  value_type& value(size_t slot);
+  const value_type& value(size_t slot) const;
+
+  size_t FindSlot(int id) const;
+  size_t InsertSlot(int id);
+  void EraseSlot(size_t slot);
+
+  size_t GetBucket(int id) const;
+  void Rehash(size_t bucket_count);
+
+  void SortOrder() const;
+  size_t GetPosition(size_t slot, size_t position) const;
+
+  std::vector<std::unique_ptr<Chunk>> chunks_;
+  std::vector<int> ids_;
+  std::vector<bool> used_;
+  std::vector<size_t> free_slots_;
+  size_t size_ = 0;
+
+  // Slot + 1 for each bucket, or 0 if the bucket is empty
+  std::vector<size_t> buckets_;
+
+  // Slots in ascending order of IDs, sorted again after an insertion. Erased
+  // slots stay in place and are skipped.
+  mutable std::vector<size_t> order_;
+  mutable bool order_changed_ = false;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+inline ItemStore::value_type& ItemStore::value(size_t slot) {
+  return *reinterpret_cast<value_type*>(
+      &chunks_[slot / kChunkSize]->slots[slot % kChunkSize]);
+}
+
+inline const ItemStore::value_type& ItemStore::value(size_t slot) const {
+  return *reinterpret_cast<const value_type*>(
+      &chunks_[slot / kChunkSize]->slots[slot % kChunkSize]);
+}
+
+}  // namespace anime
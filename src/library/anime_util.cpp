@@ -190,7 +190,7 @@ bool MetadataNeedsRefresh(const Item& item) {
 
   if (item.GetSynopsis().empty())
     return true;
-  if (item.GetGenres().empty())
+  if (!item.HasGenres())
     return true;
   if (item.GetScore() == kUnknownScore && IsAiredYet(item))
     return true;
@@ -205,8 +205,8 @@ bool IsNsfw(const Item& item) {
     return true;
 
   if (item.GetAgeRating() == anime::kUnknownAgeRating) {
-    auto& genres = item.GetGenres();
-    if (std::find(genres.begin(), genres.end(), L"Hentai") != genres.end())
+    static const auto hentai = library::InternString(L"Hentai");
+    if (item.HasGenre(hentai))
       return true;
   }
 
@@ -33,6 +33,7 @@
 #include "taiga/path.h"
 #include "taiga/settings.h"
 #include "taiga/taiga.h"
+#include "track/recognition.h"
 #include "ui/dlg/dlg_season.h"
 #include "ui/ui.h"
 
@@ -96,6 +97,8 @@ bool SeasonDatabase::LoadString(const std::wstring& data) {
 
   items.clear();
 
+  Meow.BeginTitleUpdates();  // Publish all title changes at once
+
   foreach_xmlnode_(node, season_node, L"anime") {
     std::map<enum_t, std::wstring> id_map;
 
@@ -141,6 +144,8 @@ bool SeasonDatabase::LoadString(const std::wstring& data) {
     items.push_back(anime_id);
   }
 
+  Meow.EndTitleUpdates();
+
   if (!items.empty())
     AnimeDatabase.SaveDatabase();
 
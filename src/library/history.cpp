@@ -26,6 +26,7 @@
 #include "sync/sync.h"
 #include "taiga/announce.h"
 #include "taiga/path.h"
+#include "taiga/save_queue.h"
 #include "taiga/settings.h"
 #include "taiga/taiga.h"
 #include "track/media.h"
@@ -445,51 +446,60 @@ void History::ReadQueue(const pugi::xml_document& document) {
 }
 
 bool History::Save() {
-  xml_document document;
-  std::wstring path = taiga::GetPath(taiga::Path::UserHistory);
-
-  // Write meta
-  xml_node node_meta = document.append_child(L"meta");
-  XmlWriteStrValue(node_meta, L"version", StrToWstr(Taiga.version.to_string()).c_str());
-
-  xml_node node_history = document.append_child(L"history");
+  // Copied, as the history is written on another thread
+  using items_t = std::pair<std::vector<HistoryItem>, std::vector<HistoryItem>>;
+  const auto history = std::make_shared<items_t>(items, queue.items);
+
+  auto serialize = [this, history]() {
+    xml_document document;
+
+    // Write meta
+    xml_node node_meta = document.append_child(L"meta");
+    XmlWriteStrValue(node_meta, L"version", StrToWstr(Taiga.version.to_string()).c_str());
+
+    xml_node node_history = document.append_child(L"history");
+
+    // Write items
+    xml_node node_items = node_history.append_child(L"items");
+    for (const auto& history_item : history->first) {
+      xml_node node_item = node_items.append_child(L"item");
+      node_item.append_attribute(L"anime_id") = history_item.anime_id;
+      node_item.append_attribute(L"episode") = *history_item.episode;
+      node_item.append_attribute(L"time") = history_item.time.c_str();
+    }
+    // Write queue
+    xml_node node_queue = node_history.append_child(L"queue");
+    for (const auto& history_item : history->second) {
+      xml_node node_item = node_queue.append_child(L"item");
+      #define APPEND_ATTRIBUTE_INT(x, y) \
+          if (y) node_item.append_attribute(x) = *y;
+      #define APPEND_ATTRIBUTE_STR(x, y) \
+          if (y) node_item.append_attribute(x) = (*y).c_str();
+      #define APPEND_ATTRIBUTE_DATE(x, y) \
+          if (y) node_item.append_attribute(x) = std::wstring(*y).c_str();
+      node_item.append_attribute(L"anime_id") = history_item.anime_id;
+      node_item.append_attribute(L"mode") = TranslateModeToString(history_item.mode).c_str();
+      node_item.append_attribute(L"time") = history_item.time.c_str();
+      APPEND_ATTRIBUTE_INT(L"episode", history_item.episode);
+      APPEND_ATTRIBUTE_INT(L"score", history_item.score);
+      APPEND_ATTRIBUTE_INT(L"status", history_item.status);
+      APPEND_ATTRIBUTE_INT(L"enable_rewatching", history_item.enable_rewatching);
+      APPEND_ATTRIBUTE_INT(L"rewatched_times", history_item.rewatched_times);
+      APPEND_ATTRIBUTE_STR(L"tags", history_item.tags);
+      APPEND_ATTRIBUTE_STR(L"notes", history_item.notes);
+      APPEND_ATTRIBUTE_DATE(L"date_start", history_item.date_start);
+      APPEND_ATTRIBUTE_DATE(L"date_finish", history_item.date_finish);
+      #undef APPEND_ATTRIBUTE_DATE
+      #undef APPEND_ATTRIBUTE_STR
+      #undef APPEND_ATTRIBUTE_INT
+    }
 
-  // Write items
-  xml_node node_items = node_history.append_child(L"items");
-  for (const auto& history_item : items) {
-    xml_node node_item = node_items.append_child(L"item");
-    node_item.append_attribute(L"anime_id") = history_item.anime_id;
-    node_item.append_attribute(L"episode") = *history_item.episode;
-    node_item.append_attribute(L"time") = history_item.time.c_str();
-  }
-  // Write queue
-  xml_node node_queue = node_history.append_child(L"queue");
-  for (const auto& history_item : queue.items) {
-    xml_node node_item = node_queue.append_child(L"item");
-    #define APPEND_ATTRIBUTE_INT(x, y) \
-        if (y) node_item.append_attribute(x) = *y;
-    #define APPEND_ATTRIBUTE_STR(x, y) \
-        if (y) node_item.append_attribute(x) = (*y).c_str();
-    #define APPEND_ATTRIBUTE_DATE(x, y) \
-        if (y) node_item.append_attribute(x) = std::wstring(*y).c_str();
-    node_item.append_attribute(L"anime_id") = history_item.anime_id;
-    node_item.append_attribute(L"mode") = TranslateModeToString(history_item.mode).c_str();
-    node_item.append_attribute(L"time") = history_item.time.c_str();
-    APPEND_ATTRIBUTE_INT(L"episode", history_item.episode);
-    APPEND_ATTRIBUTE_INT(L"score", history_item.score);
-    APPEND_ATTRIBUTE_INT(L"status", history_item.status);
-    APPEND_ATTRIBUTE_INT(L"enable_rewatching", history_item.enable_rewatching);
-    APPEND_ATTRIBUTE_INT(L"rewatched_times", history_item.rewatched_times);
-    APPEND_ATTRIBUTE_STR(L"tags", history_item.tags);
-    APPEND_ATTRIBUTE_STR(L"notes", history_item.notes);
-    APPEND_ATTRIBUTE_DATE(L"date_start", history_item.date_start);
-    APPEND_ATTRIBUTE_DATE(L"date_finish", history_item.date_finish);
-    #undef APPEND_ATTRIBUTE_DATE
-    #undef APPEND_ATTRIBUTE_STR
-    #undef APPEND_ATTRIBUTE_INT
-  }
+    return XmlWriteDocumentToString(document);
+  };
 
-  return XmlWriteDocumentToFile(document, path);
+  std::wstring path = taiga::GetPath(taiga::Path::UserHistory);
+  taiga::save_queue.Add(path, serialize);
+  return true;
 }
 
 int History::TranslateModeFromString(const std::wstring& mode) {
@@ -16,10 +16,91 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
 #include "metadata.h"
 
 namespace library {
 
+// Strings never move once they are added, so that views of them can be used
+// as keys
+static std::deque<string_t> interned_strings;
+static std::unordered_map<std::wstring_view, symbol_t> interned_symbols;
+static std::mutex interned_mutex;
+
+static symbol_t Intern(std::wstring_view str) {
+  auto it = interned_symbols.find(str);
+  if (it != interned_symbols.end())
+    return it->second;
+
+  const auto symbol = static_cast<symbol_t>(interned_strings.size());
+  interned_strings.emplace_back(str);
+  interned_symbols.emplace(interned_strings.back(), symbol);
+  return symbol;
+}
+
+symbol_t InternString(std::wstring_view str) {
+  std::lock_guard<std::mutex> lock(interned_mutex);
+  return Intern(str);
+}
+
+std::vector<symbol_t> InternStrings(const std::vector<string_t>& strings) {
+  std::vector<symbol_t> symbols;
+  symbols.reserve(strings.size());
+
+  std::lock_guard<std::mutex> lock(interned_mutex);
+  for (const auto& str : strings)
+    if (!str.empty())
+      symbols.push_back(Intern(str));
+
+  return symbols;
+}
+
+std::vector<symbol_t> InternStrings(std::wstring_view str,
+                                    std::wstring_view delimiter) {
+  std::vector<symbol_t> symbols;
+
+  std::lock_guard<std::mutex> lock(interned_mutex);
+
+  if (delimiter.empty()) {
+    if (!str.empty())
+      symbols.push_back(Intern(str));
+    return symbols;
+  }
+
+  while (!str.empty()) {
+    const auto pos = str.find(delimiter);
+    const auto value = str.substr(0, pos);
+    if (!value.empty())
+      symbols.push_back(Intern(value));
+    if (pos == str.npos)
+      break;
+    str.remove_prefix(pos + delimiter.size());
+  }
+
+  return symbols;
+}
+
+const string_t& GetInternedString(symbol_t symbol) {
+  std::lock_guard<std::mutex> lock(interned_mutex);
+  return interned_strings.at(symbol);
+}
+
+std::vector<string_t> GetInternedStrings(const std::vector<symbol_t>& symbols) {
+  std::vector<string_t> strings;
+  strings.reserve(symbols.size());
+
+  std::lock_guard<std::mutex> lock(interned_mutex);
+  for (const auto symbol : symbols)
+    strings.push_back(interned_strings.at(symbol));
+
+  return strings;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 Title::Title()
     : type(TitleType::Synonym) {
 }
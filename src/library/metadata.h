@@ -18,11 +18,25 @@
 
 #pragma once
 
+#include <cstdint>
+#include <string_view>
+
 #include "base/time.h"
 #include "base/types.h"
 
 namespace library {
 
+// Strings that are shared by many items, such as genres and producers, are
+// stored once and referred to by their symbols.
+typedef uint32_t symbol_t;
+
+symbol_t InternString(std::wstring_view str);
+std::vector<symbol_t> InternStrings(const std::vector<string_t>& strings);
+std::vector<symbol_t> InternStrings(std::wstring_view str,
+                                    std::wstring_view delimiter);
+const string_t& GetInternedString(symbol_t symbol);
+std::vector<string_t> GetInternedStrings(const std::vector<symbol_t>& symbols);
+
 enum class TitleType {
   Unknown,
   Synonym,
@@ -58,8 +72,8 @@ struct Metadata {
   std::vector<unsigned short> extent;
   std::vector<Date> date;
 
-  std::vector<string_t> subject;
-  std::vector<string_t> creator;
+  std::vector<symbol_t> subject;
+  std::vector<symbol_t> creator;
   std::vector<string_t> resource;
   std::vector<string_t> community;
 
@@ -30,6 +30,7 @@
 #include "taiga/http.h"
 #include "taiga/settings.h"
 #include "taiga/taiga.h"
+#include "track/recognition.h"
 #include "ui/ui.h"
 
 sync::Manager ServiceManager;
@@ -193,7 +194,9 @@ void Manager::HandleError(Response& response, HttpResponse& http_response) {
 void Manager::HandleResponse(Response& response, HttpResponse& http_response) {
   // Let the service do its thing
   Service& service = *services_[response.service_id].get();
+  Meow.BeginTitleUpdates();  // Publish all title changes at once
   service.HandleResponse(response, http_response);
+  Meow.EndTitleUpdates();
 
   // Check for error
   if (response.data.count(L"error")) {
@@ -16,9 +16,18 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <vector>
+
+#include "base/file.h"
+#include "base/log.h"
 #include "base/string.h"
+#include "base/xml.h"
 #include "library/anime_db.h"
+#include "library/anime_episode.h"
 #include "taiga/debug.h"
+#include "taiga/path.h"
+#include "track/recognition.h"
 #include "ui/dlg/dlg_main.h"
 #include "ui/dialog.h"
 
@@ -77,4 +86,160 @@ void Test() {
   test.Stop(str, true);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+class Timings {
+public:
+  void Add(std::chrono::steady_clock::duration duration) {
+    using duration_t =
+        std::chrono::duration<double, std::chrono::microseconds::period>;
+    values_.push_back(std::chrono::duration_cast<duration_t>(duration).count());
+  }
+
+  std::wstring ToString() {
+    if (values_.empty())
+      return L"-";
+
+    std::sort(values_.begin(), values_.end());
+    double total = 0.0;
+    for (const auto& value : values_)
+      total += value;
+
+    auto percentile = [this](double p) {
+      const auto index = static_cast<size_t>(p * (values_.size() - 1));
+      return ToWstr(values_.at(index), 1);
+    };
+
+    return ToWstr(values_.size() / (total / 1000000.0), 0) + L"/s | " +
+           L"p50 " + percentile(0.5) + L"us | " +
+           L"p90 " + percentile(0.9) + L"us | " +
+           L"p99 " + percentile(0.99) + L"us | " +
+           L"max " + ToWstr(values_.back(), 1) + L"us";
+  }
+
+private:
+  std::vector<double> values_;
+};
+
+// The corpus is identified against the fixed database and relations in
+// data/test/, rather than the user's own, with default settings. It is in the
+// following format, where the source is either "file" (file paths), "media"
+// (browser titles) or empty (release names):
+//
+// <recognition>
+//   <item>
+//     <title>[Group] Title - 01 [720p].mkv</title>
+//     <source>file</source>
+//     <id>1234</id>
+//   </item>
+// </recognition>
+bool BenchmarkRecognition() {
+  const auto path = taiga::GetPath(taiga::Path::TestRecognition);
+
+  xml_document document;
+  const unsigned int options = pugi::parse_default & ~pugi::parse_eol;
+  const xml_parse_result parse_result =
+      document.load_file(path.c_str(), options);
+
+  if (parse_result.status != pugi::status_ok) {
+    LOGE(L"Could not read recognition corpus: {}", path);
+    return false;
+  }
+
+  // Items may have been added along with the settings
+  AnimeDatabase.items.clear();
+
+  const auto database_path = taiga::GetPath(taiga::Path::TestDatabase);
+  if (!AnimeDatabase.LoadDatabase(database_path)) {
+    LOGE(L"Could not read recognition database: {}", database_path);
+    return false;
+  }
+
+  // The compiled relations of the user are left alone
+  const auto relations_path = taiga::GetPath(taiga::Path::TestRelations);
+  std::string relations;
+  if (!ReadFromFile(relations_path, relations) ||
+      !Meow.ReadRelations(relations, false)) {
+    LOGE(L"Could not read recognition relations: {}", relations_path);
+    return false;
+  }
+
+  using clock_t = std::chrono::steady_clock;
+
+  // Titles are built from scratch before we start measuring the rest
+  auto t0 = clock_t::now();
+  Meow.RebuildTitles();
+  Timings build_timings;
+  build_timings.Add(clock_t::now() - t0);
+  Meow.ResetStats();
+
+  Timings parse_timings;
+  Timings identify_timings;
+  size_t item_count = 0;
+  size_t parsed_count = 0;
+  size_t correct_count = 0;
+  std::wstring mismatches;
+
+  xml_node recognition_node = document.child(L"recognition");
+  foreach_xmlnode_(item_node, recognition_node, L"item") {
+    const auto title = XmlReadStrValue(item_node, L"title");
+    const auto source = XmlReadStrValue(item_node, L"source");
+    const int expected_id = XmlReadIntValue(item_node, L"id");
+
+    // Sources are release names unless specified otherwise
+    track::recognition::ParseOptions parse_options;
+    parse_options.parse_path = source == L"file";
+    parse_options.streaming_media = source == L"media";
+
+    track::recognition::MatchOptions match_options;
+    match_options.allow_sequels = true;
+    match_options.check_airing_date = true;
+    match_options.check_anime_type = true;
+    match_options.check_episode_number = true;
+
+    ++item_count;
+    anime::Episode episode;
+
+    t0 = clock_t::now();
+    const bool parsed = Meow.Parse(title, parse_options, episode);
+    parse_timings.Add(clock_t::now() - t0);
+
+    if (parsed) {
+      ++parsed_count;
+      t0 = clock_t::now();
+      Meow.Identify(episode, false, match_options);
+      identify_timings.Add(clock_t::now() - t0);
+    }
+
+    if (episode.anime_id == expected_id) {
+      ++correct_count;
+    } else {
+      mismatches += L"  [expected " + ToWstr(expected_id) +
+                    L", got " + ToWstr(episode.anime_id) + L"] " +
+                    title + L"\r\n";
+    }
+  }
+
+  std::wstring report;
+  report += L"Recognition benchmark\r\n\r\n";
+  report += L"Items: " + ToWstr(item_count) +
+            L" (parsed: " + ToWstr(parsed_count) + L")\r\n";
+  report += L"Accuracy: " + ToWstr(correct_count) + L"/" +
+            ToWstr(item_count) + L"\r\n\r\n";
+  report += L"Database: " + ToWstr(AnimeDatabase.items.size()) + L" items\r\n";
+  report += L"Build titles: " + build_timings.ToString() + L"\r\n";
+  report += L"Parse: " + parse_timings.ToString() + L"\r\n";
+  report += L"Identify: " + identify_timings.ToString() + L"\r\n";
+  report += L"\r\nStages:\r\n" +
+            track::recognition::FormatEngineStats(Meow.GetStats());
+  if (!mismatches.empty())
+    report += L"\r\nMismatches:\r\n" + mismatches;
+
+  LOGI(L"Recognition benchmark: {}/{} correct", correct_count, item_count);
+
+  const auto report_path =
+      taiga::GetPath(taiga::Path::Test) + L"recognition_benchmark.txt";
+  return SaveToFile(WstrToStr(report), report_path);
+}
+
 }  // namespace debug
@@ -39,4 +39,8 @@ private:
 void Print(std::wstring text);
 void Test();
 
+// Replays the corpus in test\recognition.xml through the recognition engine,
+// and saves throughput, latency and accuracy figures next to it
+bool BenchmarkRecognition();
+
 }  // namespace debug
@@ -66,8 +66,14 @@ std::wstring GetPath(Path path) {
       return data_path + L"db\\anime.xml";
     case Path::DatabaseAnimeRelations:
       return data_path + L"db\\anime-relations.txt";
+    case Path::DatabaseAnimeRelationsCompiled:
+      return data_path + L"db\\anime-relations.bin";
+    case Path::DatabaseAnimeSnapshot:
+      return data_path + L"db\\anime.bin";
     case Path::DatabaseImage:
       return data_path + L"db\\image\\";
+    case Path::DatabaseRecognition:
+      return data_path + L"db\\recognition.bin";
     case Path::DatabaseSeason:
       return data_path + L"db\\season\\";
     case Path::Feed:
@@ -80,8 +86,12 @@ std::wstring GetPath(Path path) {
       return data_path + L"settings.xml";
     case Path::Test:
       return data_path + L"test\\";
+    case Path::TestDatabase:
+      return data_path + L"test\\anime.xml";
     case Path::TestRecognition:
       return data_path + L"test\\recognition.xml";
+    case Path::TestRelations:
+      return data_path + L"test\\anime-relations.txt";
     case Path::Theme:
       return data_path + L"theme\\";
     case Path::ThemeCurrent:
@@ -92,6 +102,8 @@ std::wstring GetPath(Path path) {
       return data_path + L"user\\" + GetUserDirectoryName() + L"\\history.xml";
     case Path::UserLibrary:
       return data_path + L"user\\" + GetUserDirectoryName() + L"\\anime.xml";
+    case Path::UserLibraryJournal:
+      return data_path + L"user\\" + GetUserDirectoryName() + L"\\anime.journal";
   }
 }
 
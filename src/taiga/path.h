@@ -31,19 +31,25 @@ enum class Path {
   Database,
   DatabaseAnime,
   DatabaseAnimeRelations,
+  DatabaseAnimeRelationsCompiled,
+  DatabaseAnimeSnapshot,
   DatabaseImage,
+  DatabaseRecognition,
   DatabaseSeason,
   Feed,
   FeedHistory,
   Media,
   Settings,
   Test,
+  TestDatabase,
   TestRecognition,
+  TestRelations,
   Theme,
   ThemeCurrent,
   User,
   UserHistory,
-  UserLibrary
+  UserLibrary,
+  UserLibraryJournal
 };
 
 std::wstring GetUserDirectoryName(const sync::ServiceId service_id);
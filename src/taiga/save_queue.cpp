@@ -0,0 +1,108 @@
+/*
+** Taiga
+** Copyright (C) 2010-2018, Eren Okka
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "base/file.h"
+#include "base/log.h"
+#include "taiga/save_queue.h"
+
+namespace taiga {
+
+// Requests wait this long for more changes before they are written
+constexpr auto kSaveDelay = std::chrono::seconds(1);
+
+SaveQueue save_queue;
+
+SaveQueue::~SaveQueue() {
+  Shutdown();
+}
+
+void SaveQueue::Add(const std::wstring& path, serialize_t serialize,
+                    callback_t on_saved) {
+  Request request{path, std::move(serialize), std::move(on_saved),
+                  std::chrono::steady_clock::now()};
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!stopped_) {
+      auto it = std::find_if(requests_.begin(), requests_.end(),
+          [&path](const Request& request) { return request.path == path; });
+      if (it != requests_.end()) {
+        it->serialize = std::move(request.serialize);
+        it->on_saved = std::move(request.on_saved);
+      } else {
+        requests_.push_back(std::move(request));
+      }
+
+      if (!thread_.joinable())
+        thread_ = std::thread(&SaveQueue::Run, this);
+      condition_.notify_one();
+      return;
+    }
+  }
+
+  Save(request);
+}
+
+void SaveQueue::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  condition_.notify_one();
+
+  if (thread_.joinable())
+    thread_.join();
+}
+
+void SaveQueue::Save(const Request& request) {
+  const bool result = SaveToFileAtomic(request.serialize(), request.path);
+  if (!result)
+    LOGE(L"Could not save file: {}", request.path);
+
+  if (request.on_saved)
+    request.on_saved(result);
+}
+
+void SaveQueue::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (true) {
+    condition_.wait(lock, [this]() { return stopped_ || !requests_.empty(); });
+
+    if (requests_.empty())
+      break;  // stopped
+
+    // Give more changes a chance to arrive, unless we are shutting down
+    const auto time = requests_.front().time + kSaveDelay;
+    condition_.wait_until(lock, time, [this, &time]() {
+      return stopped_ || std::chrono::steady_clock::now() >= time;
+    });
+
+    auto request = std::move(requests_.front());
+    requests_.pop_front();
+
+    lock.unlock();
+    Save(request);
+    lock.lock();
+  }
+}
+
+}  // namespace taiga
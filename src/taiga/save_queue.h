@@ -0,0 +1,73 @@
+/*
+** Taiga
+** Copyright (C) 2010-2018, Eren Okka
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace taiga {
+
+// Writes files on a background thread. The data to save is captured by the
+// caller, then serialized and written by the worker. Requests for a file that
+// arrive before its previous request is started replace that request, so that
+// bursts of changes are saved once.
+class SaveQueue {
+public:
+  using serialize_t = std::function<std::string()>;
+  using callback_t = std::function<void(bool)>;
+
+  SaveQueue() = default;
+  SaveQueue(const SaveQueue&) = delete;
+  SaveQueue& operator=(const SaveQueue&) = delete;
+  ~SaveQueue();
+
+  // The callback is called on the worker thread, after the file is written
+  void Add(const std::wstring& path, serialize_t serialize,
+           callback_t on_saved = nullptr);
+
+  // Writes pending requests and stops the worker. Later requests are written
+  // right away.
+  void Shutdown();
+
+private:
+  struct Request {
+    std::wstring path;
+    serialize_t serialize;
+    callback_t on_saved;
+    std::chrono::steady_clock::time_point time;
+  };
+
+  static void Save(const Request& request);
+  void Run();
+
+  std::deque<Request> requests_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::thread thread_;
+  bool stopped_ = false;
+};
+
+extern SaveQueue save_queue;
+
+}  // namespace taiga
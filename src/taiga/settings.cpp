@@ -41,6 +41,7 @@
 #include "taiga/version.h"
 #include "track/media.h"
 #include "track/monitor.h"
+#include "track/recognition.h"
 #include "ui/dlg/dlg_anime_list.h"
 #include "ui/dlg/dlg_season.h"
 #include "ui/menu.h"
@@ -333,6 +334,15 @@ bool AppSettings::Load() {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void AppSettings::LoadDefaults() {
+  InitializeMap();
+
+  for (auto& pair : map_)
+    pair.second.value = pair.second.default_value;
+
+  library_folders.clear();
+}
+
 bool AppSettings::Save() {
   xml_document document;
   xml_node settings = document.append_child(L"settings");
@@ -467,6 +477,9 @@ void AppSettings::ApplyChanges(const std::wstring& previous_service,
   ui::Menus.UpdateFolders();
 
   timers.UpdateIntervalsFromSettings();
+
+  // Recognition results depend on settings such as ignored strings
+  Meow.InvalidateCache();
 }
 
 void AppSettings::RestoreDefaults() {
@@ -178,6 +178,7 @@ extern const std::wstring kDefaultTorrentSource;
 class AppSettings : public base::Settings {
 public:
   bool Load();
+  void LoadDefaults();
   bool Save();
 
   void ApplyChanges(const std::wstring& previous_service,
@@ -25,12 +25,15 @@
 #include "library/anime_db.h"
 #include "library/history.h"
 #include "taiga/announce.h"
+#include "taiga/debug.h"
 #include "taiga/dummy.h"
 #include "taiga/resource.h"
+#include "taiga/save_queue.h"
 #include "taiga/settings.h"
 #include "taiga/taiga.h"
 #include "taiga/version.h"
 #include "track/media.h"
+#include "track/recognition.h"
 #include "ui/dialog.h"
 #include "ui/menu.h"
 #include "ui/theme.h"
@@ -42,6 +45,7 @@ namespace taiga {
 
 App::App()
     : allow_multiple_instances(false),
+      benchmark_mode(false),
 #ifdef _DEBUG
       debug_mode(true)
 #else
@@ -75,7 +79,7 @@ BOOL App::InitInstance() {
        GetFileLastModifiedDate(module_path));
 
   // Check another instance
-  if (!allow_multiple_instances) {
+  if (!allow_multiple_instances && !benchmark_mode) {
     if (CheckInstance(L"Taiga-33d5a63c-de90-432f-9a8b-f6f733dab258",
                       L"TaigaMainW")) {
       LOGD(L"Another instance of Taiga is running.");
@@ -87,6 +91,15 @@ BOOL App::InitInstance() {
   InitCommonControls(ICC_STANDARD_CLASSES);
   OleInitialize(nullptr);
 
+  // Run the recognition benchmark without creating any windows, and without
+  // loading the user's settings, database or list
+  if (benchmark_mode) {
+    Settings.LoadDefaults();
+    debug::BenchmarkRecognition();
+    taiga::save_queue.Shutdown();  // waits for pending saves
+    return FALSE;
+  }
+
   // Load data
   LoadData();
 
@@ -121,7 +134,12 @@ void App::Uninitialize() {
   // Save
   Settings.Save();
   AnimeDatabase.SaveDatabase();
+  AnimeDatabase.CompactListJournal(true);
   Aggregator.SaveArchive();
+  taiga::save_queue.Shutdown();  // waits for pending saves
+
+  // Dump recognition stats for the debug log
+  Meow.LogStats();
 
   // Exit
   PostQuitMessage();
@@ -143,6 +161,9 @@ void App::ParseCommandLineArguments() {
     } else if (argument == L"-allowmultipleinstances") {
       allow_multiple_instances = true;
       LOGD(argument);
+    } else if (argument == L"-benchmark") {
+      benchmark_mode = true;
+      LOGD(argument);
     } else {
       LOGW(L"Invalid argument: {}", argument);
     }
@@ -164,6 +185,8 @@ void App::LoadData() {
   AnimeDatabase.LoadDatabase();
   AnimeDatabase.LoadList();
   AnimeDatabase.ClearInvalidItems();
+  // The list may add anime of its own, so the tables are built after it
+  Meow.InitializeTitlesAsync();  // Build recognition tables in the background
 
   History.Load();
 }
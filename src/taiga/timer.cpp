@@ -41,6 +41,7 @@ namespace taiga {
 Timer timer_anime_list(kTimerAnimeList, 60);    //  1 minute
 Timer timer_detection(kTimerDetection, 3);      //  3 seconds
 Timer timer_history(kTimerHistory, 5 * 60);     //  5 minutes
+Timer timer_journal(kTimerJournal, 60);         //  1 minute
 Timer timer_library(kTimerLibrary, 30 * 60);    // 30 minutes
 Timer timer_media(kTimerMedia, 2 * 60, false);  //  2 minutes
 Timer timer_memory(kTimerMemory, 10 * 60);      // 10 minutes
@@ -74,6 +75,10 @@ void Timer::OnTimeout() {
         History.queue.Check(true);
       break;
 
+    case kTimerJournal:
+      AnimeDatabase.CompactListJournal();
+      break;
+
     case kTimerLibrary:
       ScanAvailableEpisodesQuick();
       break;
@@ -117,6 +122,7 @@ void TimerManager::Initialize() {
   InsertTimer(&timer_anime_list);
   InsertTimer(&timer_detection);
   InsertTimer(&timer_history);
+  InsertTimer(&timer_journal);
   InsertTimer(&timer_library);
   InsertTimer(&timer_media);
   InsertTimer(&timer_memory);
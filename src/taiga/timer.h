@@ -26,6 +26,7 @@ enum TimerIds {
   kTimerAnimeList = 1,
   kTimerDetection,
   kTimerHistory,
+  kTimerJournal,
   kTimerLibrary,
   kTimerMedia,
   kTimerMemory,
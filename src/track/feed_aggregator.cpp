@@ -86,7 +86,10 @@ bool Aggregator::CheckFeed(FeedCategory category, const std::wstring& source,
 }
 
 void Aggregator::ExamineData(Feed& feed) {
-  for (auto& feed_item : feed.items) {
+  std::vector<std::wstring> titles;
+  titles.reserve(feed.items.size());
+
+  for (const auto& feed_item : feed.items) {
     auto title = feed_item.title;
     switch (feed.source) {
       case FeedSource::AnimeBytes: {
@@ -104,19 +107,25 @@ void Aggregator::ExamineData(Feed& feed) {
       }
     }
 
-    auto& episode_data = feed_item.episode_data;
+    titles.push_back(title);
+  }
 
-    // Examine title and compare with anime list items
-    static track::recognition::ParseOptions parse_options;
-    parse_options.parse_path = false;
-    parse_options.streaming_media = false;
-    Meow.Parse(title, parse_options, episode_data);
-    static track::recognition::MatchOptions match_options;
-    match_options.allow_sequels = true;
-    match_options.check_airing_date = true;
-    match_options.check_anime_type = true;
-    match_options.check_episode_number = true;
-    Meow.Identify(episode_data, false, match_options);
+  // Examine titles and compare with anime list items
+  static track::recognition::ParseOptions parse_options;
+  parse_options.parse_path = false;
+  parse_options.streaming_media = false;
+  static track::recognition::MatchOptions match_options;
+  match_options.allow_sequels = true;
+  match_options.check_airing_date = true;
+  match_options.check_anime_type = true;
+  match_options.check_episode_number = true;
+  std::vector<anime::Episode> episodes;
+  Meow.RecognizeBatch(titles, parse_options, match_options, episodes);
+
+  for (size_t i = 0; i < feed.items.size(); ++i) {
+    auto& feed_item = feed.items[i];
+    auto& episode_data = feed_item.episode_data;
+    static_cast<anime::Episode&>(episode_data) = episodes[i];
 
     // Update last aired episode number
     if (anime::IsValidId(episode_data.anime_id)) {
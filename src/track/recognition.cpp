@@ -16,6 +16,10 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 #include <anitomy/anitomy/anitomy.h>
 #include <anitomy/anitomy/keyword.h>
 
@@ -33,6 +37,51 @@ track::recognition::Engine Meow;
 namespace track {
 namespace recognition {
 
+// Anitomy instances are reused by each thread, which saves us from setting up
+// their options and reallocating their buffers for every file
+struct ParserContext {
+  ParserContext() {
+    streaming_media.options().allowed_delimiters = L" ";
+
+    for (auto parser : {&season, &directory}) {
+      parser->options().parse_episode_number = false;
+      parser->options().parse_episode_title = false;
+      parser->options().parse_file_extension = false;
+    }
+    season.options().parse_release_group = false;
+    directory.options().parse_release_group = true;
+  }
+
+  anitomy::Anitomy& GetFileParser(const ParseOptions& parse_options) {
+    auto& parser = parse_options.streaming_media ? streaming_media : filename;
+
+    // Ignored strings are split again only when the setting changes
+    const auto& value = Settings[taiga::kRecognition_IgnoredStrings];
+    if (value != ignored_strings) {
+      ignored_strings = value;
+      for (auto instance : {&filename, &streaming_media}) {
+        instance->options().ignored_strings.clear();
+        Split(value, L"|", instance->options().ignored_strings);
+      }
+    }
+
+    return parser;
+  }
+
+  anitomy::Anitomy filename;
+  anitomy::Anitomy streaming_media;
+  anitomy::Anitomy season;     // Used for season numbers in directory names
+  anitomy::Anitomy directory;  // Used for anime titles in directory names
+  std::wstring ignored_strings;
+};
+
+static ParserContext& GetParserContext() {
+  thread_local ParserContext context;
+  return context;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 bool Engine::Parse(std::wstring filename, const ParseOptions& parse_options,
                    anime::Episode& episode) const {
   // Clear previous data
@@ -49,13 +98,7 @@ bool Engine::Parse(std::wstring filename, const ParseOptions& parse_options,
   if (filename.empty())
     return false;
 
-  anitomy::Anitomy anitomy_instance;
-
-  // Set Anitomy options
-  if (parse_options.streaming_media)
-    anitomy_instance.options().allowed_delimiters = L" ";
-  Split(Settings[taiga::kRecognition_IgnoredStrings], L"|",
-        anitomy_instance.options().ignored_strings);
+  auto& anitomy_instance = GetParserContext().GetFileParser(parse_options);
 
   if (!anitomy_instance.Parse(filename)) {
     LOGD(L"Could not parse filename: {}", filename);
@@ -72,9 +115,18 @@ bool Engine::Parse(std::wstring filename, const ParseOptions& parse_options,
 
 int Engine::Identify(anime::Episode& episode, bool give_score,
                      const MatchOptions& match_options) {
+  return Identify(episode, give_score, match_options, scores_);
+}
+
+int Engine::Identify(anime::Episode& episode, bool give_score,
+                     const MatchOptions& match_options,
+                     sorted_scores_t& scores) {
   std::set<int> anime_ids;
 
   InitializeTitles();
+  const auto tables = GetTitleTables();
+
+  identify_calls_.fetch_add(1, std::memory_order_relaxed);
 
   auto valide_ids = [&](anime::Episode& episode) {
     for (auto it = anime_ids.begin(); it != anime_ids.end(); ) {
@@ -95,8 +147,12 @@ int Engine::Identify(anime::Episode& episode, bool give_score,
       episode_merged_title.elements().erase(element);
     }
     episode_merged_title.set_anime_title(merged_title);
-    LookUpTitle(episode_merged_title.anime_title(), anime_ids);
+    const auto start = std::chrono::steady_clock::now();
+    LookUpTitle(*tables, episode_merged_title.anime_title(), anime_ids);
+    const auto candidates = anime_ids.size();
     valide_ids(episode_merged_title);
+    RecordStage(Stage::MergedTitleLookup, candidates, !anime_ids.empty(),
+                start);
     if (!anime_ids.empty()) {
       std::swap(episode_merged_title, episode);
       LOGD(L"Merged title lookup succeeded: {}", episode.anime_title());
@@ -120,18 +176,24 @@ int Engine::Identify(anime::Episode& episode, bool give_score,
 
   // Look up anime title
   if (anime_ids.empty()) {
-    LookUpTitle(episode.anime_title(), anime_ids);
+    const auto start = std::chrono::steady_clock::now();
+    LookUpTitle(*tables, episode.anime_title(), anime_ids);
+    const auto candidates = anime_ids.size();
     valide_ids(episode);
+    RecordStage(Stage::TitleLookup, candidates, !anime_ids.empty(), start);
   }
 
   // Look up parent directories
   if (anime_ids.empty() && !episode.folder.empty() &&
       Settings.GetBool(taiga::kRecognition_LookupParentDirectories) &&
       episode.anime_type().empty()) {
+    const auto start = std::chrono::steady_clock::now();
+    size_t candidates = 0;
     anime::Episode episode_from_directory(episode);
     episode_from_directory.elements().erase(anitomy::kElementAnimeTitle);
     if (GetTitleFromPath(episode_from_directory)) {
-      LookUpTitle(episode_from_directory.anime_title(), anime_ids);
+      LookUpTitle(*tables, episode_from_directory.anime_title(), anime_ids);
+      candidates = anime_ids.size();
       valide_ids(episode_from_directory);
       if (!anime_ids.empty()) {
         std::swap(episode_from_directory, episode);
@@ -140,6 +202,18 @@ int Engine::Identify(anime::Episode& episode, bool give_score,
              episode.anime_title());
       }
     }
+    RecordStage(Stage::DirectoryLookup, candidates, !anime_ids.empty(), start);
+  }
+
+  // Look up titles that are a typo or two away from the anime title
+  if (anime_ids.empty()) {
+    const auto start = std::chrono::steady_clock::now();
+    LookUpTypo(*tables, episode.anime_title(), anime_ids);
+    const auto candidates = anime_ids.size();
+    valide_ids(episode);
+    RecordStage(Stage::TypoLookup, candidates, !anime_ids.empty(), start);
+    if (!anime_ids.empty())
+      LOGD(L"Typo lookup succeeded: {}", episode.anime_title());
   }
 
   // Figure out which ID is the one we're looking for
@@ -153,9 +227,10 @@ int Engine::Identify(anime::Episode& episode, bool give_score,
   } else if (anime_ids.size() == 1) {
     episode.anime_id = *anime_ids.begin();
   } else if (anime_ids.size() > 1) {
-    episode.anime_id = ScoreTitle(episode, anime_ids, match_options);
+    episode.anime_id =
+        ScoreTitle(*tables, episode, anime_ids, match_options, scores);
   } else if (anime_ids.empty() && give_score) {
-    ScoreTitle(episode, anime_ids, match_options);
+    ScoreTitle(*tables, episode, anime_ids, match_options, scores);
   }
 
   // Post-processing
@@ -188,6 +263,42 @@ int Engine::Identify(anime::Episode& episode, bool give_score,
   return episode.anime_id;
 }
 
+void Engine::IdentifyBatch(std::vector<anime::Episode>& episodes,
+                           const MatchOptions& match_options) {
+  if (episodes.empty())
+    return;
+
+  // Titles must be ready before the workers start reading them
+  InitializeTitles();
+
+  std::atomic<size_t> next_index{0};
+
+  auto worker = [&]() {
+    sorted_scores_t scores;
+    for (size_t i = next_index++; i < episodes.size(); i = next_index++) {
+      Identify(episodes[i], false, match_options, scores);
+    }
+  };
+
+  // Starting a thread costs more than identifying a few episodes, so small
+  // batches are identified on the calling thread alone
+  constexpr size_t kMinEpisodesPerThread = 16;
+
+  const size_t thread_count = std::min<size_t>(
+      std::max(1u, std::thread::hardware_concurrency()),
+      (episodes.size() + kMinEpisodesPerThread - 1) / kMinEpisodesPerThread);
+
+  std::vector<std::thread> threads;
+  threads.reserve(thread_count - 1);
+  for (size_t i = 1; i < thread_count; ++i)
+    threads.emplace_back(worker);
+
+  worker();  // The calling thread takes part as well
+
+  for (auto& thread : threads)
+    thread.join();
+}
+
 bool Engine::Search(const std::wstring& title, std::vector<int>& anime_ids) {
   anime::Episode episode;
   episode.set_anime_title(title);
@@ -197,9 +308,10 @@ bool Engine::Search(const std::wstring& title, std::vector<int>& anime_ids) {
 
   InitializeTitles();
 
-  ScoreTitle(episode, empty_set, default_options);
+  sorted_scores_t scores;
+  ScoreTitle(*GetTitleTables(), episode, empty_set, default_options, scores);
 
-  for (const auto& score : scores_) {
+  for (const auto& score : scores) {
     anime_ids.push_back(score.first);
   }
 
@@ -209,36 +321,196 @@ bool Engine::Search(const std::wstring& title, std::vector<int>& anime_ids) {
 ////////////////////////////////////////////////////////////////////////////////
 
 void Engine::InitializeTitles() {
-  static bool initialized = false;
+  if (titles_initialized_.load(std::memory_order_acquire))
+    return;
 
-  if (!initialized) {
-    initialized = true;
-    for (const auto& it : AnimeDatabase.items) {
-      UpdateTitles(it.second);
-    }
+  // Callers wait here until the tables are ready, unless they were already
+  // built in the background by the time we got here
+  InitializeTitlesAsync();
+  GetTitlesReady().wait();
+}
+
+void Engine::InitializeTitlesAsync() {
+  std::lock_guard<std::mutex> lock(titles_ready_mutex_);
+
+  if (titles_ready_.valid())
+    return;
+
+  // Reading relations touches the settings, so it is not left to the worker
+  ReadRelations();
+
+  // The database may change while we're building the tables, so the worker
+  // thread gets its own copy of the items
+  auto items = CopyTitleItems();
+
+  {
+    std::lock_guard<std::mutex> update_lock(title_update_mutex_);
+    building_titles_ = true;
+  }
+
+  titles_ready_ = std::async(std::launch::async,
+      [this, items = std::move(items)]() {
+        BuildTitles(items, true);
+      }).share();
+}
+
+void Engine::RebuildTitles() {
+  // A build that is still in progress would replace our tables once finished
+  auto titles_ready = GetTitlesReady();
+  if (titles_ready.valid())
+    titles_ready.wait();
+
+  const auto items = CopyTitleItems();
+
+  {
+    std::lock_guard<std::mutex> update_lock(title_update_mutex_);
+    building_titles_ = true;
+  }
+
+  // The title index is neither read nor written, so that the tables are
+  // always built from scratch
+  BuildTitles(items, false);
+}
+
+std::shared_future<void> Engine::GetTitlesReady() {
+  std::lock_guard<std::mutex> lock(titles_ready_mutex_);
+  return titles_ready_;
+}
+
+std::vector<anime::Item> Engine::CopyTitleItems() const {
+  std::vector<anime::Item> items;
+  items.reserve(AnimeDatabase.items.size());
+
+  for (const auto& it : AnimeDatabase.items) {
+    const auto& anime_item = it.second;
+    if (anime::IsValidId(anime_item.GetId()) &&
+        it.first == anime_item.GetId())
+      items.push_back(anime_item);
+  }
+
+  return items;
+}
+
+void Engine::BuildTitles(const std::vector<anime::Item>& items,
+                         bool use_title_index) {
+  // Building the tables is expensive, so we reuse the ones from a previous
+  // session as long as the database has not changed since
+  const auto checksum = use_title_index ? GetTitleIndexChecksum(items) : 0;
+  auto tables = std::make_shared<TitleTables>();
+  if (!use_title_index || !ReadTitleIndex(checksum, *tables)) {
+    tables = std::make_shared<TitleTables>();
+    for (const auto& anime_item : items)
+      UpdateTitleTables(*tables, anime_item, false);
+    if (use_title_index)
+      WriteTitleIndex(checksum, *tables);
+  }
+  UpdateTypoIndex(*tables);
+
+  {
+    std::lock_guard<std::mutex> lock(title_update_mutex_);
+
+    // Items that were updated in the meantime are applied on top, and the
+    // tables are published even if a batch of updates is in progress
+    for (const auto& update : deferred_title_updates_)
+      UpdateTitleTables(*tables, update.first, update.second);
+    deferred_title_updates_.clear();
+    building_titles_ = false;
+
+    pending_title_tables_ = std::move(tables);
+    PublishTitleTables();
 
-    ReadRelations();
+    // Set along with the tables, so that no update is missed in between
+    titles_initialized_.store(true, std::memory_order_release);
+  }
+}
+
+void Engine::BeginTitleUpdates() {
+  std::lock_guard<std::mutex> lock(title_update_mutex_);
+  ++title_update_depth_;
+}
+
+void Engine::EndTitleUpdates() {
+  std::lock_guard<std::mutex> lock(title_update_mutex_);
+  if (title_update_depth_ > 0 && --title_update_depth_ == 0) {
+    PublishTitleTables();
+    // Anime metadata may have changed even if the titles have not
+    InvalidateCache();
+  }
+}
+
+std::shared_ptr<const Engine::TitleTables> Engine::GetTitleTables() const {
+  return std::atomic_load(&title_tables_);
+}
+
+void Engine::PublishTitleTables() {
+  if (pending_title_tables_) {
+    UpdateTypoIndex(*pending_title_tables_);
+    std::atomic_store(&title_tables_,
+        std::shared_ptr<const TitleTables>(std::move(pending_title_tables_)));
+    InvalidateCache();
   }
 }
 
 void Engine::UpdateTitles(const anime::Item& anime_item, bool erase_ids) {
+  std::lock_guard<std::mutex> lock(title_update_mutex_);
+
+  if (building_titles_) {
+    deferred_title_updates_.emplace_back(anime_item, erase_ids);
+    return;
+  }
+
+  // The item will be read from the database once the tables are built
+  if (!titles_initialized_.load(std::memory_order_acquire))
+    return;
+
+  // Readers may still be using the current generation, so we work on a copy
+  if (!pending_title_tables_)
+    pending_title_tables_ = std::make_shared<TitleTables>(*GetTitleTables());
+
+  UpdateTitleTables(*pending_title_tables_, anime_item, erase_ids);
+
+  if (title_update_depth_ == 0)
+    PublishTitleTables();
+}
+
+void Engine::UpdateTitleTables(TitleTables& tables,
+                               const anime::Item& anime_item,
+                               bool erase_ids) const {
   const int anime_id = anime_item.GetId();
 
-  db_[anime_id].normal_titles.clear();
-  db_[anime_id].trigrams.clear();
+  const auto range = tables.db.Find(anime_id);
+  for (auto i = range.begin; i < range.end; ++i) {
+    const auto trigrams = range.trigrams(i);
+    for (uint32_t j = 0; j < range.trigram_count(i); ++j) {
+      auto ids = tables.trigram_index.find_mutable(trigrams[j]);
+      if (ids && ids->erase(anime_id) && ids->empty())
+        tables.trigram_index.erase(trigrams[j]);
+    }
+  }
+
+  std::vector<std::wstring> score_titles;
+  std::vector<trigram_container_t> score_trigrams;
+
+  auto& title_keys = tables.title_keys[anime_id];
+  auto& normal_title_keys = tables.normal_title_keys[anime_id];
 
   if (erase_ids) {
-    auto erase_id = [&anime_id](Titles::container_t& titles) {
-      for (auto& title : titles) {
-        title.second.erase(anime_id);
+    auto erase_id = [&anime_id](Titles& titles,
+                                std::set<std::wstring>& keys) {
+      const auto containers = {
+        &titles.alternative, &titles.main, &titles.user
+      };
+      for (const auto& key : keys) {
+        for (auto container : containers) {
+          auto ids = container->find_mutable(key);
+          if (ids && ids->erase(anime_id) && ids->empty())
+            container->erase(key);
+        }
       }
+      keys.clear();
     };
-    erase_id(titles_.alternative);
-    erase_id(titles_.main);
-    erase_id(titles_.user);
-    erase_id(normal_titles_.alternative);
-    erase_id(normal_titles_.main);
-    erase_id(normal_titles_.user);
+    erase_id(tables.titles, title_keys);
+    erase_id(tables.normal_titles, normal_title_keys);
   }
 
   auto update_title = [&](std::wstring title,
@@ -248,47 +520,57 @@ void Engine::UpdateTitles(const anime::Item& anime_item, bool erase_ids) {
       Normalize(title, kNormalizeForTrigrams, false);
       trigram_container_t trigrams;
       GetTrigrams(title, trigrams);
-      db_[anime_id].trigrams.push_back(trigrams);
-      db_[anime_id].normal_titles.push_back(title);
+      for (const auto& trigram : trigrams)
+        tables.trigram_index[trigram].insert(anime_id);
+      score_trigrams.push_back(std::move(trigrams));
+      score_titles.push_back(title);
 
       Normalize(title, kNormalizeForLookup, true);
       titles[title].insert(anime_id);
+      title_keys.insert(title);
 
       Normalize(title, kNormalizeFull, true);
       normal_titles[title].insert(anime_id);
+      normal_title_keys.insert(title);
+      AddTypoKey(tables, title);
     }
   };
 
-  update_title(anime_item.GetTitle(), titles_.main, normal_titles_.main);
-  update_title(anime_item.GetEnglishTitle(), titles_.main, normal_titles_.main);
-  update_title(anime_item.GetJapaneseTitle(), titles_.main, normal_titles_.main);
+  auto& titles = tables.titles;
+  auto& normal_titles = tables.normal_titles;
+
+  update_title(anime_item.GetTitle(), titles.main, normal_titles.main);
+  update_title(anime_item.GetEnglishTitle(), titles.main, normal_titles.main);
+  update_title(anime_item.GetJapaneseTitle(), titles.main, normal_titles.main);
 
   const auto& date = anime_item.GetDateStart();
   if (anime::IsValidDate(date)) {
     std::wstring year = ToWstr(date.year());
     if (anime_item.GetTitle().find(year) == std::wstring::npos) {
       update_title(anime_item.GetTitle() + L" (" + year + L")",
-                   titles_.alternative, normal_titles_.alternative);
+                   titles.alternative, normal_titles.alternative);
     }
   }
 
   for (const auto& synonym : anime_item.GetSynonyms()) {
-    update_title(synonym, titles_.alternative, normal_titles_.alternative);
+    update_title(synonym, titles.alternative, normal_titles.alternative);
   }
   for (const auto& synonym : anime_item.GetUserSynonyms()) {
-    update_title(synonym, titles_.user, normal_titles_.user);
+    update_title(synonym, titles.user, normal_titles.user);
   }
+
+  tables.db.Assign(anime_id, score_titles, score_trigrams);
 }
 
-int Engine::LookUpTitle(std::wstring title, std::set<int>& anime_ids) const {
+int Engine::LookUpTitle(const TitleTables& tables, std::wstring title,
+                        std::set<int>& anime_ids) const {
   int anime_id = anime::ID_UNKNOWN;
 
   auto find_title = [&](const std::wstring& title,
                         const Titles::container_t& container) {
     if (!anime::IsValidId(anime_id)) {
-      auto it = container.find(title.c_str());
-      if (it != container.end()) {
-        anime_ids.insert(it->second.begin(), it->second.end());
+      if (const auto ids = container.find(title)) {
+        anime_ids.insert(ids->begin(), ids->end());
         if (anime_ids.size() == 1)
           anime_id = *anime_ids.begin();
       }
@@ -296,17 +578,17 @@ int Engine::LookUpTitle(std::wstring title, std::set<int>& anime_ids) const {
   };
 
   Normalize(title, kNormalizeForLookup, false);
-  find_title(title, titles_.user);
-  find_title(title, titles_.main);
-  find_title(title, titles_.alternative);
+  find_title(title, tables.titles.user);
+  find_title(title, tables.titles.main);
+  find_title(title, tables.titles.alternative);
 
   if (anime_ids.size() == 1)
     return anime_id;
 
   Normalize(title, kNormalizeFull, true);
-  find_title(title, normal_titles_.user);
-  find_title(title, normal_titles_.main);
-  find_title(title, normal_titles_.alternative);
+  find_title(title, tables.normal_titles.user);
+  find_title(title, tables.normal_titles.main);
+  find_title(title, tables.normal_titles.alternative);
 
   return anime_id;
 }
@@ -351,11 +633,44 @@ void Engine::ExtendAnimeTitle(anime::Episode& episode) const {
   }
 }
 
-bool Engine::GetTitleFromPath(anime::Episode& episode) {
+bool Engine::GetTitleFromPath(anime::Episode& episode) const {
   if (episode.folder.empty())
     return false;
 
-  std::wstring path = episode.folder;
+  const auto directory_info = GetDirectoryInfo(episode.folder);
+
+  if (directory_info.anime_season && !episode.anime_season())
+    episode.set_anime_season(directory_info.anime_season);
+
+  if (directory_info.anime_title.empty())
+    return false;
+
+  episode.set_anime_title(directory_info.anime_title);
+  if (!directory_info.anime_year.empty())
+    episode.SetElementValue(anitomy::kElementAnimeYear,
+                            directory_info.anime_year);
+
+  auto find_number_in_string = [](const std::wstring& str) {
+    auto it = std::find_if(str.begin(), str.end(), IsNumericChar);
+    return it == str.end() ? str.npos : (it - str.begin());
+  };
+
+  if (episode.elements().empty(anitomy::kElementEpisodeNumber)) {
+    const auto& filename = episode.file_name();
+    auto pos = find_number_in_string(filename);
+    if (pos == 0)  // begins with a number (e.g. "01.mkv", "02 - Title.mkv")
+      episode.set_episode_number(ToInt(filename.substr(pos)));
+  }
+
+  ExtendAnimeTitle(episode);
+
+  return true;
+}
+
+DirectoryInfo Engine::ParseDirectory(const std::wstring& folder) const {
+  DirectoryInfo directory_info;
+
+  std::wstring path = folder;
 
   for (const auto& library_folder : Settings.library_folders) {
     if (StartsWith(path, library_folder)) {
@@ -384,11 +699,7 @@ bool Engine::GetTitleFromPath(anime::Episode& episode) {
   };
 
   auto get_season_number = [](const std::wstring& str) {
-    anitomy::Anitomy anitomy_instance;
-    anitomy_instance.options().parse_episode_number = false;
-    anitomy_instance.options().parse_episode_title = false;
-    anitomy_instance.options().parse_file_extension = false;
-    anitomy_instance.options().parse_release_group = false;
+    auto& anitomy_instance = GetParserContext().season;
     anitomy_instance.Parse(str);
     auto it = anitomy_instance.elements().find(anitomy::kElementAnimeSeason);
     if (it != anitomy_instance.elements().end())
@@ -408,52 +719,28 @@ bool Engine::GetTitleFromPath(anime::Episode& episode) {
       break;
     int number = get_season_number(directory);
     if (number) {
-      if (!episode.anime_season())
-        episode.set_anime_season(number);
+      if (!directory_info.anime_season)
+        directory_info.anime_season = number;
     } else {
-      episode.set_anime_title(directory);
+      directory_info.anime_title = directory;
       break;
     }
   }
 
-  if (episode.anime_title().empty()) {
-    return false;
-  } else {
+  if (!directory_info.anime_title.empty()) {
     // We're parsing the directory name in case it looks like
     // "[Fansub] Anime Title [Stuff]" rather than just "Anime Title".
-    anitomy::Anitomy anitomy_instance;
-    anitomy_instance.options().parse_episode_number = false;
-    anitomy_instance.options().parse_episode_title = false;
-    anitomy_instance.options().parse_file_extension = false;
-    anitomy_instance.options().parse_release_group = true;
-    if (anitomy_instance.Parse(episode.anime_title())) {
+    auto& anitomy_instance = GetParserContext().directory;
+    if (anitomy_instance.Parse(directory_info.anime_title)) {
       auto& elements = anitomy_instance.elements();
-      const auto valid_elements = {
-        anitomy::kElementAnimeTitle,
-        anitomy::kElementAnimeYear
-      };
-      for (const auto& element : valid_elements) {
-        if (!elements.empty(element))
-          episode.SetElementValue(element, elements.get(element));
-      }
+      if (!elements.empty(anitomy::kElementAnimeTitle))
+        directory_info.anime_title = elements.get(anitomy::kElementAnimeTitle);
+      if (!elements.empty(anitomy::kElementAnimeYear))
+        directory_info.anime_year = elements.get(anitomy::kElementAnimeYear);
     }
   }
 
-  auto find_number_in_string = [](const std::wstring& str) {
-    auto it = std::find_if(str.begin(), str.end(), IsNumericChar);
-    return it == str.end() ? str.npos : (it - str.begin());
-  };
-
-  if (episode.elements().empty(anitomy::kElementEpisodeNumber)) {
-    const auto& filename = episode.file_name();
-    auto pos = find_number_in_string(filename);
-    if (pos == 0)  // begins with a number (e.g. "01.mkv", "02 - Title.mkv")
-      episode.set_episode_number(ToInt(filename.substr(pos)));
-  }
-
-  ExtendAnimeTitle(episode);
-
-  return true;
+  return directory_info;
 }
 
 }  // namespace recognition
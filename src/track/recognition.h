@@ -18,11 +18,19 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "base/shared_map.h"
 #include "base/string.h"
 
 namespace anime {
@@ -48,14 +56,79 @@ struct MatchOptions {
   bool check_episode_number = false;
 };
 
+struct CacheStats {
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t size = 0;
+};
+
+struct DirectoryInfo {
+  std::wstring anime_title;
+  std::wstring anime_year;
+  int anime_season = 0;
+};
+
+enum class Stage {
+  MergedTitleLookup,
+  TitleLookup,
+  DirectoryLookup,
+  TypoLookup,
+  Redirection,
+  TrigramScoring,
+  DatabaseScoring,
+  FinalScoring,
+};
+
+constexpr size_t kStageCount = 8;
+
+struct StageStats {
+  unsigned long long calls = 0;
+  unsigned long long candidates = 0;  // IDs that reached the stage
+  unsigned long long successes = 0;
+  unsigned long long microseconds = 0;
+};
+
+struct EngineStats {
+  unsigned long long identify_calls = 0;
+  std::array<StageStats, kStageCount> stages;
+
+  const StageStats& at(Stage stage) const;
+};
+
+std::wstring GetStageName(Stage stage);
+std::wstring FormatEngineStats(const EngineStats& stats);
+
+class TypoIndex;
+
 class Engine {
 public:
   bool Parse(std::wstring filename, const ParseOptions& parse_options, anime::Episode& episode) const;
   int Identify(anime::Episode& episode, bool give_score, const MatchOptions& match_options);
+  int Identify(anime::Episode& episode, bool give_score, const MatchOptions& match_options, sorted_scores_t& scores);
+  void IdentifyBatch(std::vector<anime::Episode>& episodes, const MatchOptions& match_options);
   bool Search(const std::wstring& title, std::vector<int>& anime_ids);
 
+  bool Recognize(const std::wstring& str, const ParseOptions& parse_options, const MatchOptions& match_options, anime::Episode& episode);
+  void RecognizeBatch(const std::vector<std::wstring>& titles, const ParseOptions& parse_options, const MatchOptions& match_options, std::vector<anime::Episode>& episodes);
+  void InvalidateCache();
+  CacheStats GetCacheStats() const;
+
+  // Directories are parsed once per scan, rather than once per file
+  void BeginDirectoryScan();
+  void EndDirectoryScan();
+  DirectoryInfo GetDirectoryInfo(const std::wstring& folder) const;
+
+  EngineStats GetStats() const;
+  void ResetStats();
+  void LogStats() const;
+
   void InitializeTitles();
+  void InitializeTitlesAsync();
+  void RebuildTitles();
+  std::shared_future<void> GetTitlesReady();
   void UpdateTitles(const anime::Item& anime_item, bool erase_ids = false);
+  void BeginTitleUpdates();
+  void EndTitleUpdates();
 
   sorted_scores_t GetScores() const;
 
@@ -67,7 +140,7 @@ public:
   bool IsAudioFileExtension(const std::wstring& extension) const;
 
   bool ReadRelations();
-  bool ReadRelations(const std::string& document);
+  bool ReadRelations(const std::string& document, bool use_compiled_data = true);
   bool SearchEpisodeRedirection(int id, const std::pair<int, int>& range, int& destination_id, std::pair<int, int>& destination_range) const;
 
 private:
@@ -82,35 +155,129 @@ private:
   bool ValidateOptions(anime::Episode& episode, const anime::Item& anime_item, const MatchOptions& match_options, bool redirect) const;
   bool ValidateEpisodeNumber(anime::Episode& episode, const anime::Item& anime_item, const MatchOptions& match_options, bool redirect) const;
 
-  int LookUpTitle(std::wstring title, std::set<int>& anime_ids) const;
-  bool GetTitleFromPath(anime::Episode& episode);
+  struct TitleTables;
+
+  int LookUpTitle(const TitleTables& tables, std::wstring title, std::set<int>& anime_ids) const;
+  bool GetTitleFromPath(anime::Episode& episode) const;
+  DirectoryInfo ParseDirectory(const std::wstring& folder) const;
   void ExtendAnimeTitle(anime::Episode& episode) const;
 
-  int ScoreTitle(anime::Episode& episode, const std::set<int>& anime_ids, const MatchOptions& match_options);
-  int ScoreTitle(const std::wstring& str, const anime::Episode& episode, const scores_t& trigram_results);
+  int ScoreTitle(const TitleTables& tables, anime::Episode& episode, const std::set<int>& anime_ids, const MatchOptions& match_options, sorted_scores_t& scores) const;
+  int ScoreTitle(const TitleTables& tables, const std::wstring& str, const anime::Episode& episode, const scores_t& trigram_results, sorted_scores_t& scores) const;
+
+  std::vector<anime::Item> CopyTitleItems() const;
+  void BuildTitles(const std::vector<anime::Item>& items, bool use_title_index);
+  void UpdateTitleTables(TitleTables& tables, const anime::Item& anime_item, bool erase_ids) const;
 
   void Normalize(std::wstring& title, int type, bool normalized_before) const;
   void NormalizeUnicode(std::wstring& str) const;
   void ErasePunctuation(std::wstring& str, int type, bool modified_tail) const;
-  void EraseUnnecessary(std::wstring& str) const;
-  void ConvertOrdinalNumbers(std::wstring& str) const;
   void ConvertRomanNumbers(std::wstring& str) const;
-  void ConvertSeasonNumbers(std::wstring& str) const;
+  void ConvertWords(std::wstring& str) const;
   void Transliterate(std::wstring& str) const;
 
   struct Titles {
-    typedef std::map<std::wstring, std::set<int>> container_t;
+    typedef base::shared_map<std::wstring, std::set<int>> container_t;
     container_t alternative;
     container_t main;
     container_t user;
-  } normal_titles_, titles_;
+  };
 
-  struct ScoreStore {
-    std::vector<std::wstring> normal_titles;
-    std::vector<trigram_container_t> trigrams;
+  // Normalized titles and their trigrams, kept in flat arrays that are
+  // indexed by anime ID. Titles of an anime are stored next to each other, so
+  // that scoring them walks through memory in order. IDs are grouped into
+  // chunks, which copies of the store share until they are modified.
+  class ScoreStore {
+  public:
+    class Chunk;
+
+    // Titles of an anime ID, in the chunk that they are stored in
+    struct Range {
+      const Chunk* chunk = nullptr;
+      uint32_t begin = 0;
+      uint32_t end = 0;
+
+      std::wstring_view title(uint32_t index) const;
+      uint32_t title_length(uint32_t index) const;
+      const trigram_t* trigrams(uint32_t index) const;
+      uint32_t trigram_count(uint32_t index) const;
+    };
+
+    void Assign(int id, const std::vector<std::wstring>& titles,
+                const std::vector<trigram_container_t>& trigrams);
+    Range Find(int id) const;
+    int max_id() const;
+
+  private:
+    static constexpr size_t kChunkSize = 256;  // IDs per chunk
+
+    std::vector<std::shared_ptr<Chunk>> chunks_;
   };
-  std::map<int, ScoreStore> db_;
+
+  // Readers hold on to an immutable generation of the tables for as long as
+  // they need it. Writers modify a pending copy, which replaces the current
+  // generation when the outermost update is finished. Copies share everything
+  // but the parts that are modified.
+  struct TitleTables {
+    Titles normal_titles;
+    Titles titles;
+    // Keys that each anime ID was inserted under, for fast removal
+    base::shared_map<int, std::set<std::wstring>> normal_title_keys;
+    base::shared_map<int, std::set<std::wstring>> title_keys;
+    ScoreStore db;
+    base::shared_map<trigram_t, std::set<int>, 4096> trigram_index;
+    // Normal title keys as of the last full build of the typo index, which
+    // may include keys that have since been removed, and the keys that were
+    // added after it. The latter are few enough to index with each generation.
+    std::shared_ptr<const TypoIndex> typo_index;
+    std::shared_ptr<const TypoIndex> recent_typo_index;
+    std::vector<std::wstring> recent_typo_keys;
+  };
+
+  std::shared_ptr<const TitleTables> GetTitleTables() const;
+  void PublishTitleTables();
+
+  int LookUpTypo(const TitleTables& tables, std::wstring title, std::set<int>& anime_ids) const;
+  void AddTypoKey(TitleTables& tables, const std::wstring& key) const;
+  void UpdateTypoIndex(TitleTables& tables) const;
+
+  uint64_t GetTitleIndexChecksum(const std::vector<anime::Item>& items) const;
+  bool ReadTitleIndex(uint64_t checksum, TitleTables& tables) const;
+  bool WriteTitleIndex(uint64_t checksum, const TitleTables& tables) const;
+
+  std::shared_ptr<const TitleTables> title_tables_ =
+      std::make_shared<TitleTables>();
+  std::shared_ptr<TitleTables> pending_title_tables_;
+  std::mutex title_update_mutex_;
+  int title_update_depth_ = 0;
+
+  // Items that are updated while the tables are being built from an earlier
+  // copy of the database, which are applied once the build is finished
+  bool building_titles_ = false;
+  std::vector<std::pair<anime::Item, bool>> deferred_title_updates_;
+
   sorted_scores_t scores_;
+
+  // Moves whenever recognition data changes, invalidating cached results
+  std::atomic<unsigned int> generation_{0};
+
+  std::shared_future<void> titles_ready_;
+  std::atomic<bool> titles_initialized_{false};
+  std::mutex titles_ready_mutex_;
+
+  // Always-on counters for each stage of Identify, updated without locking
+  struct StageCounters {
+    std::atomic<unsigned long long> calls{0};
+    std::atomic<unsigned long long> candidates{0};
+    std::atomic<unsigned long long> successes{0};
+    std::atomic<unsigned long long> microseconds{0};
+  };
+
+  void RecordStage(Stage stage, size_t candidates, bool success,
+                   std::chrono::steady_clock::time_point start) const;
+
+  mutable std::array<StageCounters, kStageCount> stage_counters_;
+  std::atomic<unsigned long long> identify_calls_{0};
 };
 
 }  // namespace recognition
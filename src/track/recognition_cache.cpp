@@ -0,0 +1,308 @@
+/*
+** Taiga
+** Copyright (C) 2010-2018, Eren Okka
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "base/string.h"
+#include "base/time.h"
+#include "library/anime_episode.h"
+#include "track/recognition.h"
+
+namespace track {
+namespace recognition {
+
+// Least recently used results of Parse + Identify. Results are only valid for
+// the generation of the recognition data they were computed with, and for the
+// day they were computed on, as validation depends on airing dates.
+class Cache {
+public:
+  bool Find(const std::wstring& key, unsigned int generation,
+            bool& parsed, anime::Episode& episode);
+  void Insert(const std::wstring& key, unsigned int generation,
+              bool parsed, const anime::Episode& episode);
+
+  CacheStats GetStats();
+
+private:
+  void Validate(unsigned int generation);
+
+  struct Entry {
+    std::wstring key;
+    bool parsed;
+    anime::Episode episode;
+  };
+
+  static constexpr size_t kCapacity = 4096;
+
+  std::list<Entry> entries_;
+  std::unordered_map<std::wstring, std::list<Entry>::iterator> index_;
+  unsigned int generation_ = 0;
+  Date date_;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+  std::mutex mutex_;
+};
+
+// Parsed directories, which are only kept for the length of a scan
+class DirectoryCache {
+public:
+  void Begin();
+  void End();
+
+  bool Find(const std::wstring& folder, unsigned int generation,
+            DirectoryInfo& directory_info);
+  void Insert(const std::wstring& folder, unsigned int generation,
+              const DirectoryInfo& directory_info);
+
+private:
+  std::unordered_map<std::wstring, DirectoryInfo> entries_;
+  unsigned int generation_ = 0;
+  int depth_ = 0;
+  std::mutex mutex_;
+};
+
+Cache cache;
+DirectoryCache directory_cache;
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Cache::Find(const std::wstring& key, unsigned int generation,
+                 bool& parsed, anime::Episode& episode) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  Validate(generation);
+
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    ++misses_;
+    return false;
+  }
+
+  // Move to front
+  entries_.splice(entries_.begin(), entries_, it->second);
+
+  parsed = it->second->parsed;
+  episode = it->second->episode;
+  ++hits_;
+  return true;
+}
+
+void Cache::Insert(const std::wstring& key, unsigned int generation,
+                   bool parsed, const anime::Episode& episode) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  Validate(generation);
+
+  // Recognition data has changed while we were computing the result
+  if (generation != generation_)
+    return;
+
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    entries_.erase(it->second);
+    index_.erase(it);
+  }
+
+  entries_.push_front({key, parsed, episode});
+  index_[key] = entries_.begin();
+
+  if (entries_.size() > kCapacity) {
+    index_.erase(entries_.back().key);
+    entries_.pop_back();
+  }
+}
+
+CacheStats Cache::GetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  CacheStats stats;
+  stats.hits = hits_;
+  stats.misses = misses_;
+  stats.size = entries_.size();
+  return stats;
+}
+
+void Cache::Validate(unsigned int generation) {
+  const Date date = GetDateJapan();
+
+  if (generation > generation_ || date != date_) {
+    entries_.clear();
+    index_.clear();
+    generation_ = std::max(generation, generation_);
+    date_ = date;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void DirectoryCache::Begin() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  ++depth_;
+}
+
+void DirectoryCache::End() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (depth_ > 0 && --depth_ == 0)
+    entries_.clear();
+}
+
+bool DirectoryCache::Find(const std::wstring& folder, unsigned int generation,
+                          DirectoryInfo& directory_info) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (!depth_)
+    return false;
+
+  if (generation > generation_) {
+    entries_.clear();
+    generation_ = generation;
+  }
+
+  auto it = entries_.find(folder);
+  if (it == entries_.end())
+    return false;
+
+  directory_info = it->second;
+  return true;
+}
+
+void DirectoryCache::Insert(const std::wstring& folder,
+                            unsigned int generation,
+                            const DirectoryInfo& directory_info) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (depth_ && generation == generation_)
+    entries_[folder] = directory_info;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static std::wstring GetCacheKey(const std::wstring& str,
+                                const ParseOptions& parse_options,
+                                const MatchOptions& match_options) {
+  const int flags =
+      (parse_options.parse_path ? 0x01 : 0) |
+      (parse_options.streaming_media ? 0x02 : 0) |
+      (match_options.allow_sequels ? 0x04 : 0) |
+      (match_options.check_airing_date ? 0x08 : 0) |
+      (match_options.check_anime_type ? 0x10 : 0) |
+      (match_options.check_episode_number ? 0x20 : 0);
+
+  std::wstring key;
+  key.reserve(str.size() + 1);
+  key.push_back(static_cast<wchar_t>(L'0' + flags));
+  key.append(str);
+  return key;
+}
+
+bool Engine::Recognize(const std::wstring& str,
+                       const ParseOptions& parse_options,
+                       const MatchOptions& match_options,
+                       anime::Episode& episode) {
+  const auto key = GetCacheKey(str, parse_options, match_options);
+  const auto generation = generation_.load();
+
+  bool parsed = false;
+  if (cache.Find(key, generation, parsed, episode))
+    return parsed;
+
+  parsed = Parse(str, parse_options, episode);
+  if (parsed)
+    Identify(episode, false, match_options);
+
+  cache.Insert(key, generation, parsed, episode);
+
+  return parsed;
+}
+
+void Engine::RecognizeBatch(const std::vector<std::wstring>& titles,
+                            const ParseOptions& parse_options,
+                            const MatchOptions& match_options,
+                            std::vector<anime::Episode>& episodes) {
+  const auto generation = generation_.load();
+
+  std::vector<std::wstring> keys(titles.size());
+  std::vector<size_t> unidentified;
+  std::vector<anime::Episode> unidentified_episodes;
+
+  episodes.resize(titles.size());
+
+  for (size_t i = 0; i < titles.size(); ++i) {
+    keys[i] = GetCacheKey(titles[i], parse_options, match_options);
+    bool parsed = false;
+    if (cache.Find(keys[i], generation, parsed, episodes[i]))
+      continue;
+    if (Parse(titles[i], parse_options, episodes[i])) {
+      unidentified.push_back(i);
+      unidentified_episodes.push_back(episodes[i]);
+    } else {
+      cache.Insert(keys[i], generation, false, episodes[i]);
+    }
+  }
+
+  IdentifyBatch(unidentified_episodes, match_options);
+
+  for (size_t i = 0; i < unidentified.size(); ++i) {
+    const auto index = unidentified.at(i);
+    episodes[index] = unidentified_episodes.at(i);
+    cache.Insert(keys[index], generation, true, episodes[index]);
+  }
+}
+
+void Engine::InvalidateCache() {
+  ++generation_;
+}
+
+CacheStats Engine::GetCacheStats() const {
+  return cache.GetStats();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Engine::BeginDirectoryScan() {
+  directory_cache.Begin();
+}
+
+void Engine::EndDirectoryScan() {
+  directory_cache.End();
+}
+
+DirectoryInfo Engine::GetDirectoryInfo(const std::wstring& folder) const {
+  const auto generation = generation_.load();
+
+  // Trailing separators do not make a different directory
+  auto key = folder;
+  TrimRight(key, L"\\/");
+
+  DirectoryInfo directory_info;
+  if (directory_cache.Find(key, generation, directory_info))
+    return directory_info;
+
+  directory_info = ParseDirectory(folder);
+  directory_cache.Insert(key, generation, directory_info);
+
+  return directory_info;
+}
+
+}  // namespace recognition
+}  // namespace track
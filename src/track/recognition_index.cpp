@@ -0,0 +1,207 @@
+/*
+** Taiga
+** Copyright (C) 2010-2018, Eren Okka
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "base/binary.h"
+#include "base/file.h"
+#include "base/log.h"
+#include "library/anime_db.h"
+#include "library/anime_util.h"
+#include "taiga/path.h"
+#include "track/recognition.h"
+
+namespace track {
+namespace recognition {
+
+// The index must be rebuilt whenever the format or the normalization rules
+// change, so don't forget to increase the version in either case.
+constexpr uint32_t kTitleIndexMagic = 0x58444952;  // "RIDX"
+constexpr uint32_t kTitleIndexVersion = 1;
+
+uint64_t Engine::GetTitleIndexChecksum(
+    const std::vector<anime::Item>& items) const {
+  base::Checksum checksum;
+
+  // Everything that UpdateTitles reads from an item
+  for (const auto& anime_item : items) {
+    checksum.Update(anime_item.GetId());
+    checksum.Update(anime_item.GetTitle());
+    checksum.Update(anime_item.GetEnglishTitle());
+    checksum.Update(anime_item.GetJapaneseTitle());
+
+    const auto& date = anime_item.GetDateStart();
+    checksum.Update(anime::IsValidDate(date) ? date.year() : 0);
+
+    const auto synonyms = anime_item.GetSynonyms();
+    checksum.Update(static_cast<int32_t>(synonyms.size()));
+    for (const auto& synonym : synonyms)
+      checksum.Update(synonym);
+
+    const auto& user_synonyms = anime_item.GetUserSynonyms();
+    checksum.Update(static_cast<int32_t>(user_synonyms.size()));
+    for (const auto& synonym : user_synonyms)
+      checksum.Update(synonym);
+  }
+
+  return checksum.value();
+}
+
+bool Engine::ReadTitleIndex(uint64_t checksum, TitleTables& tables) const {
+  const auto path = taiga::GetPath(taiga::Path::DatabaseRecognition);
+
+  FileMapping file;
+  if (!file.Open(path))
+    return false;
+
+  base::BinaryReader reader(file.data(), file.size());
+
+  uint32_t magic = 0;
+  uint32_t version = 0;
+  uint64_t file_checksum = 0;
+  if (!reader.ReadUInt32(magic) || magic != kTitleIndexMagic ||
+      !reader.ReadUInt32(version) || version != kTitleIndexVersion ||
+      !reader.ReadUInt64(file_checksum) || file_checksum != checksum) {
+    LOGD(L"Recognition index is out of date");
+    return false;
+  }
+
+  // IDs were written in order, so each insertion goes to the end
+  auto read_titles = [&reader](Titles::container_t& container,
+      base::shared_map<int, std::set<std::wstring>>& keys) {
+    uint32_t count = 0;
+    if (!reader.ReadUInt32(count))
+      return false;
+    for (uint32_t i = 0; i < count; ++i) {
+      std::wstring title;
+      uint32_t id_count = 0;
+      if (!reader.ReadString(title) || !reader.ReadUInt32(id_count))
+        return false;
+      auto& ids = container[title];
+      for (uint32_t j = 0; j < id_count; ++j) {
+        int32_t id = 0;
+        if (!reader.ReadInt32(id))
+          return false;
+        ids.insert(ids.end(), id);
+        keys[id].insert(title);
+      }
+    }
+    return true;
+  };
+
+  auto read_db = [&reader, &tables]() {
+    uint32_t count = 0;
+    if (!reader.ReadUInt32(count))
+      return false;
+    for (uint32_t i = 0; i < count; ++i) {
+      int32_t id = 0;
+      uint32_t title_count = 0;
+      if (!reader.ReadInt32(id) || !reader.ReadUInt32(title_count))
+        return false;
+      std::vector<std::wstring> titles(title_count);
+      std::vector<trigram_container_t> title_trigrams(title_count);
+      for (uint32_t j = 0; j < title_count; ++j) {
+        auto& trigrams = title_trigrams[j];
+        uint32_t trigram_count = 0;
+        if (!reader.ReadString(titles[j]) ||
+            !reader.ReadUInt32(trigram_count) ||
+            trigram_count > reader.remaining() / sizeof(trigram_t))
+          return false;
+        trigrams.resize(trigram_count);
+        if (!reader.ReadBytes(trigrams.data(),
+                              trigram_count * sizeof(trigram_t)))
+          return false;
+        for (const auto& trigram : trigrams)
+          tables.trigram_index[trigram].insert(id);
+      }
+      tables.db.Assign(id, titles, title_trigrams);
+    }
+    return true;
+  };
+
+  if (!read_titles(tables.titles.main, tables.title_keys) ||
+      !read_titles(tables.titles.alternative, tables.title_keys) ||
+      !read_titles(tables.titles.user, tables.title_keys) ||
+      !read_titles(tables.normal_titles.main, tables.normal_title_keys) ||
+      !read_titles(tables.normal_titles.alternative,
+                   tables.normal_title_keys) ||
+      !read_titles(tables.normal_titles.user, tables.normal_title_keys) ||
+      !read_db() || reader.remaining()) {
+    LOGW(L"Recognition index is corrupted: {}", path);
+    return false;
+  }
+
+  return true;
+}
+
+bool Engine::WriteTitleIndex(uint64_t checksum,
+                             const TitleTables& tables) const {
+  base::BinaryWriter writer;
+  writer.WriteUInt32(kTitleIndexMagic);
+  writer.WriteUInt32(kTitleIndexVersion);
+  writer.WriteUInt64(checksum);
+
+  auto write_titles = [&writer](const Titles::container_t& container) {
+    writer.WriteUInt32(static_cast<uint32_t>(container.size()));
+    container.for_each([&writer](const std::wstring& title,
+                                 const std::set<int>& ids) {
+      writer.WriteString(title);
+      writer.WriteUInt32(static_cast<uint32_t>(ids.size()));
+      for (const auto& id : ids)
+        writer.WriteInt32(id);
+    });
+  };
+
+  write_titles(tables.titles.main);
+  write_titles(tables.titles.alternative);
+  write_titles(tables.titles.user);
+  write_titles(tables.normal_titles.main);
+  write_titles(tables.normal_titles.alternative);
+  write_titles(tables.normal_titles.user);
+
+  const auto& store = tables.db;
+  std::vector<int> ids;
+  for (int id = 1; id <= store.max_id(); ++id) {
+    const auto range = store.Find(id);
+    if (range.begin != range.end)
+      ids.push_back(id);
+  }
+
+  writer.WriteUInt32(static_cast<uint32_t>(ids.size()));
+  for (const auto id : ids) {
+    const auto range = store.Find(id);
+    writer.WriteInt32(id);
+    writer.WriteUInt32(range.end - range.begin);
+    for (auto i = range.begin; i < range.end; ++i) {
+      const auto title = range.title(i);
+      writer.WriteString(std::wstring(title));
+      writer.WriteUInt32(range.trigram_count(i));
+      writer.WriteBytes(range.trigrams(i),
+                        range.trigram_count(i) * sizeof(trigram_t));
+    }
+  }
+
+  const auto path = taiga::GetPath(taiga::Path::DatabaseRecognition);
+  if (!SaveToFile(writer.data(), path)) {
+    LOGW(L"Could not save recognition index: {}", path);
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace recognition
+}  // namespace track
@@ -17,6 +17,9 @@
 */
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <queue>
 
 #include <utf8proc/utf8proc.h>
 
@@ -25,6 +28,107 @@
 namespace track {
 namespace recognition {
 
+// Whole-word replacement rules compiled into an Aho-Corasick automaton. A
+// single scan tells us which rules occur in a string, and only those are
+// applied, in their original order. The string is scanned again only after a
+// replacement is made, because a replacement may enable one of the next rules
+// (e.g. "second season" -> "2nd season" -> "2").
+class ReplacementRules {
+public:
+  typedef std::pair<std::wstring, std::wstring> rule_t;  // find, replace with
+
+  // Rules are tracked by the bits of a 64-bit mask
+  static constexpr size_t kMaxRules = 64;
+
+  template <size_t N>
+  explicit ReplacementRules(const rule_t (&rules)[N])
+      : rules_(rules, rules + N), nodes_(1) {
+    static_assert(N <= kMaxRules, "Too many replacement rules");
+    Build();
+  }
+
+  void Apply(std::wstring& str) const;
+
+private:
+  void Build();
+  uint64_t Scan(const std::wstring& str) const;
+
+  // Patterns are ASCII-only; any other character resets the automaton.
+  static constexpr size_t kAlphabetSize = 128;
+
+  struct Node {
+    std::array<uint16_t, kAlphabetSize> next = {0};
+    uint64_t rules = 0;  // rules whose patterns end at this node
+  };
+
+  std::vector<rule_t> rules_;
+  std::vector<Node> nodes_;
+};
+
+void ReplacementRules::Build() {
+  // Build the trie
+  for (size_t i = 0; i < rules_.size(); ++i) {
+    size_t node = 0;
+    for (const auto c : rules_[i].first) {
+      const auto index = static_cast<size_t>(c) % kAlphabetSize;
+      if (!nodes_[node].next[index]) {
+        nodes_[node].next[index] = static_cast<uint16_t>(nodes_.size());
+        nodes_.emplace_back();
+      }
+      node = nodes_[node].next[index];
+    }
+    nodes_[node].rules |= 1ull << i;
+  }
+
+  // Turn the trie into a DFA by following the failure links, in the order of
+  // increasing depth
+  std::vector<uint16_t> fail(nodes_.size(), 0);
+  std::queue<uint16_t> queue;
+  for (const auto child : nodes_[0].next)
+    if (child)
+      queue.push(child);
+  while (!queue.empty()) {
+    const auto node = queue.front();
+    queue.pop();
+    nodes_[node].rules |= nodes_[fail[node]].rules;
+    for (size_t c = 0; c < kAlphabetSize; ++c) {
+      const auto child = nodes_[node].next[c];
+      if (child) {
+        fail[child] = nodes_[fail[node]].next[c];
+        queue.push(child);
+      } else {
+        nodes_[node].next[c] = nodes_[fail[node]].next[c];
+      }
+    }
+  }
+}
+
+uint64_t ReplacementRules::Scan(const std::wstring& str) const {
+  uint64_t found = 0;
+  size_t node = 0;
+
+  for (const auto c : str) {
+    node = c < kAlphabetSize ? nodes_[node].next[c] : 0;
+    found |= nodes_[node].rules;
+  }
+
+  return found;
+}
+
+void ReplacementRules::Apply(std::wstring& str) const {
+  uint64_t found = Scan(str);
+
+  for (size_t i = 0; found && i < rules_.size(); ++i) {
+    if (found & (1ull << i)) {
+      const auto& rule = rules_[i];
+      if (ReplaceString(str, 0, rule.first, rule.second, true, true))
+        found = Scan(str) & ~((2ull << i) - 1);  // discard previous rules
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void Engine::Normalize(std::wstring& title, int type,
                        bool normalized_before) const {
   bool modified_tail = false;
@@ -35,9 +139,7 @@ void Engine::Normalize(std::wstring& title, int type,
     ConvertRomanNumbers(title);
     Transliterate(title);
     NormalizeUnicode(title);  // Title is lower case after this point, due to UTF8PROC_CASEFOLD
-    ConvertOrdinalNumbers(title);
-    ConvertSeasonNumbers(title);
-    EraseUnnecessary(title);
+    ConvertWords(title);
     Trim(title);
 
     if (title.size() != unmodified_title.size() &&
@@ -56,53 +158,30 @@ void Engine::Normalize(std::wstring& title, int type,
       break;
   }
 
-  if (type < kNormalizeFull)
-    while (ReplaceString(title, 0, L"  ", L" ", false, true));
+  if (type < kNormalizeFull) {
+    // Collapse consecutive spaces
+    auto is_double_space = [](const wchar_t a, const wchar_t b) {
+      return a == L' ' && b == L' ';
+    };
+    title.erase(std::unique(title.begin(), title.end(), is_double_space),
+                title.end());
+  }
 }
 
 /////////////////////////////////////////////////////////////////////////////////
 
-void Engine::ConvertOrdinalNumbers(std::wstring& str) const {
-  static const std::vector<std::pair<std::wstring, std::wstring>> ordinals{
-    {L"1st", L"first"}, {L"2nd", L"second"}, {L"3rd", L"third"},
-    {L"4th", L"fourth"}, {L"5th", L"fifth"}, {L"6th", L"sixth"},
-    {L"7th", L"seventh"}, {L"8th", L"eighth"}, {L"9th", L"ninth"},
-  };
-
-  for (const auto& ordinal : ordinals)
-    ReplaceString(str, 0, ordinal.second, ordinal.first, true, true);
-}
-
 void Engine::ConvertRomanNumbers(std::wstring& str) const {
   // We skip 1 and 10 to avoid matching "I" and "X", as they're unlikely to be
   // used as Roman numerals. Any number above "XIII" is rarely used in anime
   // titles, which is why we don't need an actual Roman-to-Arabic number
   // conversion algorithm.
-  static const std::vector<std::pair<std::wstring, std::wstring>> numerals{
-    {L"2", L"II"}, {L"3", L"III"}, {L"4", L"IV"}, {L"5", L"V"},
-    {L"6", L"VI"}, {L"7", L"VII"}, {L"8", L"VIII"}, {L"9", L"IX"},
-    {L"11", L"XI"}, {L"12", L"XII"}, {L"13", L"XIII"},
-  };
-
-  for (const auto& numeral : numerals)
-    ReplaceString(str, 0, numeral.second, numeral.first, true, true);
-}
-
-void Engine::ConvertSeasonNumbers(std::wstring& str) const {
-  // This works considerably faster than regular expressions.
-  typedef std::vector<std::wstring> season_t;
-  static const std::vector<std::pair<std::wstring, season_t>> values{
-    {L"1", {L"1st season", L"season 1", L"series 1", L"s1"}},
-    {L"2", {L"2nd season", L"season 2", L"series 2", L"s2"}},
-    {L"3", {L"3rd season", L"season 3", L"series 3", L"s3"}},
-    {L"4", {L"4th season", L"season 4", L"series 4", L"s4"}},
-    {L"5", {L"5th season", L"season 5", L"series 5", L"s5"}},
-    {L"6", {L"6th season", L"season 6", L"series 6", L"s6"}},
-  };
+  static const ReplacementRules numerals{{
+    {L"II", L"2"}, {L"III", L"3"}, {L"IV", L"4"}, {L"V", L"5"},
+    {L"VI", L"6"}, {L"VII", L"7"}, {L"VIII", L"8"}, {L"IX", L"9"},
+    {L"XI", L"11"}, {L"XII", L"12"}, {L"XIII", L"13"},
+  }};
 
-  for (const auto& value : values)
-    for (const auto& season : value.second)
-      ReplaceString(str, 0, season, value.first, true, true);
+  numerals.Apply(str);
 }
 
 void Engine::Transliterate(std::wstring& str) const {
@@ -121,9 +200,79 @@ void Engine::Transliterate(std::wstring& str) const {
   }
 
   // Romanizations (Hepburn to Wapuro)
-  ReplaceString(str, 0, L"wa", L"ha", true, true);
-  ReplaceString(str, 0, L"e", L"he", true, true);
-  ReplaceString(str, 0, L"o", L"wo", true, true);
+  static const ReplacementRules romanizations{{
+    {L"wa", L"ha"}, {L"e", L"he"}, {L"o", L"wo"},
+  }};
+
+  romanizations.Apply(str);
+}
+
+// Performs the same steps as utf8proc_map, but on UTF-16 input and output,
+// using a buffer that is reused between calls
+static bool MapCodePoints(std::wstring& str, utf8proc_option_t options,
+                          std::vector<utf8proc_int32_t>& buffer) {
+  utf8proc_ssize_t length = 0;
+
+  // Decompose, with the transformations that are applied to each character
+  // (case folding, lumping, stripping marks, etc.)
+  for (size_t i = 0; i < str.size(); ++i) {
+    utf8proc_int32_t uc = str[i];
+    if (uc >= 0xD800 && uc <= 0xDFFF) {
+      // Unpaired surrogates are replaced, as they would be when converting to
+      // UTF-8
+      if (uc <= 0xDBFF && i + 1 < str.size() &&
+          str[i + 1] >= 0xDC00 && str[i + 1] <= 0xDFFF) {
+        uc = 0x10000 + ((uc - 0xD800) << 10) + (str[++i] - 0xDC00);
+      } else {
+        uc = 0xFFFD;
+      }
+    }
+    for (;;) {
+      const auto available = static_cast<utf8proc_ssize_t>(buffer.size()) - length;
+      const auto result = utf8proc_decompose_char(
+          uc, buffer.data() + length, available, options, nullptr);
+      if (result < 0)
+        return false;
+      if (result <= available) {
+        length += result;
+        break;
+      }
+      buffer.resize(std::max(buffer.size() * 2, buffer.size() + result));
+    }
+  }
+
+  // Canonical ordering of combining characters
+  for (utf8proc_ssize_t pos = 0; pos < length - 1; ) {
+    const auto uc1 = buffer[pos];
+    const auto uc2 = buffer[pos + 1];
+    const auto combining_class1 = utf8proc_get_property(uc1)->combining_class;
+    const auto combining_class2 = utf8proc_get_property(uc2)->combining_class;
+    if (combining_class1 > combining_class2 && combining_class2 > 0) {
+      buffer[pos] = uc2;
+      buffer[pos + 1] = uc1;
+      pos = pos > 0 ? pos - 1 : pos + 1;
+    } else {
+      ++pos;
+    }
+  }
+
+  // Strip control characters and compose
+  length = utf8proc_normalize_utf32(buffer.data(), length, options);
+  if (length < 0)
+    return false;
+
+  str.clear();
+  for (utf8proc_ssize_t i = 0; i < length; ++i) {
+    const auto uc = buffer[i];
+    if (uc < 0x10000) {
+      str.push_back(static_cast<wchar_t>(uc));
+    } else {
+      str.push_back(static_cast<wchar_t>(0xD800 + ((uc - 0x10000) >> 10)));
+      str.push_back(static_cast<wchar_t>(0xDC00 + ((uc - 0x10000) & 0x3FF)));
+    }
+  }
+
+  return true;
 }
 
 void Engine::NormalizeUnicode(std::wstring& str) const {
@@ -138,34 +287,76 @@ void Engine::NormalizeUnicode(std::wstring& str) const {
       // Perform unicode case folding for case-insensitive comparison
       UTF8PROC_CASEFOLD;
 
-  char* buffer = nullptr;
-  std::string temp = WstrToStr(str);
+  // Titles are treated as null-terminated strings
+  const auto null_pos = str.find(L'\0');
+  if (null_pos != str.npos)
+    str.resize(null_pos);
 
-  int length = utf8proc_map(
-      reinterpret_cast<const utf8proc_uint8_t*>(temp.data()), temp.length(),
-      reinterpret_cast<utf8proc_uint8_t**>(&buffer),
-      static_cast<utf8proc_option_t>(options));
+  // Most titles are plain ASCII, where the options above amount to case
+  // folding and replacing or stripping control characters.
+  const bool is_ascii = std::all_of(str.begin(), str.end(),
+      [](const wchar_t c) { return c < 0x80; });
 
-  if (length >= 0) {
-    temp.assign(buffer, length);
-    str = StrToWstr(temp);
+  if (is_ascii) {
+    size_t length = 0;
+    for (size_t i = 0; i < str.size(); ++i) {
+      wchar_t c = str[i];
+      switch (c) {
+        case L'\r':
+          if (i + 1 < str.size() && str[i + 1] == L'\n')
+            ++i;  // CRLF is a single line break
+          c = L' ';
+          break;
+        case L'\t':
+        case L'\n':
+        case L'\v':
+        case L'\f':
+          c = L' ';
+          break;
+        default:
+          if (c < 0x20 || c == 0x7F)
+            continue;
+          if (c >= L'A' && c <= L'Z')
+            c += L'a' - L'A';
+          break;
+      }
+      str[length++] = c;
+    }
+    str.resize(length);
+    return;
   }
 
-  if (buffer)
-    free(buffer);
+  thread_local std::vector<utf8proc_int32_t> buffer(256);
+  MapCodePoints(str, static_cast<utf8proc_option_t>(options), buffer);
 }
 
-// TODO: Rename
-void Engine::EraseUnnecessary(std::wstring& str) const {
-  ReplaceString(str, 0, L"&", L"and", true, true);
-  ReplaceString(str, 0, L"the animation", L"", true, true);
-  ReplaceString(str, 0, L"the", L"", true, true);
-  ReplaceString(str, 0, L"episode", L"", true, true);
-  ReplaceString(str, 0, L"oad", L"ova", true, true);
-  ReplaceString(str, 0, L"oav", L"ova", true, true);
-  ReplaceString(str, 0, L"specials", L"sp", true, true);
-  ReplaceString(str, 0, L"special", L"sp", true, true);
-  ReplaceString(str, 0, L"(tv)", L"", true, true);
+void Engine::ConvertWords(std::wstring& str) const {
+  // All rules are matched in a single pass, but they're applied in order.
+  static const ReplacementRules words{{
+    // Ordinal numbers
+    {L"first", L"1st"}, {L"second", L"2nd"}, {L"third", L"3rd"},
+    {L"fourth", L"4th"}, {L"fifth", L"5th"}, {L"sixth", L"6th"},
+    {L"seventh", L"7th"}, {L"eighth", L"8th"}, {L"ninth", L"9th"},
+    // Season numbers
+    {L"1st season", L"1"}, {L"season 1", L"1"}, {L"series 1", L"1"}, {L"s1", L"1"},
+    {L"2nd season", L"2"}, {L"season 2", L"2"}, {L"series 2", L"2"}, {L"s2", L"2"},
+    {L"3rd season", L"3"}, {L"season 3", L"3"}, {L"series 3", L"3"}, {L"s3", L"3"},
+    {L"4th season", L"4"}, {L"season 4", L"4"}, {L"series 4", L"4"}, {L"s4", L"4"},
+    {L"5th season", L"5"}, {L"season 5", L"5"}, {L"series 5", L"5"}, {L"s5", L"5"},
+    {L"6th season", L"6"}, {L"season 6", L"6"}, {L"series 6", L"6"}, {L"s6", L"6"},
+    // Unnecessary words
+    {L"&", L"and"},
+    {L"the animation", L""},
+    {L"the", L""},
+    {L"episode", L""},
+    {L"oad", L"ova"},
+    {L"oav", L"ova"},
+    {L"specials", L"sp"},
+    {L"special", L"sp"},
+    {L"(tv)", L""},
+  }};
+
+  words.Apply(str);
 }
 
 void Engine::ErasePunctuation(std::wstring& str, int type,
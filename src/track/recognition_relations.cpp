@@ -16,10 +16,14 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <array>
+#include <memory>
 #include <regex>
 
 #include <semaver/src/semaver.hpp>
 
+#include "base/binary.h"
 #include "base/file.h"
 #include "base/format.h"
 #include "base/log.h"
@@ -37,28 +41,88 @@ public:
   typedef std::pair<int, int> int_pair_t;
 
   void AddRange(int id, int_pair_t r1, int_pair_t r2);
-  bool FindRange(int episode_number, int_pair_t& result) const;
+  void BuildIndex();
+  bool FindRange(int episode_number, int_pair_t& result,
+                 size_t& examined) const;
 
 private:
   struct Range {
     int id;
     int_pair_t r0;
     int_pair_t r1;
+    size_t order;
   };
 
+  // Sorted by the first episode of the source range, with the largest last
+  // episode seen so far kept alongside
   std::vector<Range> ranges_;
+  std::vector<int> max_last_episodes_;
 };
 
-std::map<int, Relation> relations;
+typedef std::map<int, Relation> relations_t;
+
+// Readers may be identifying episodes while the relations are being updated,
+// so the whole set is replaced at once
+std::shared_ptr<const relations_t> relations = std::make_shared<relations_t>();
+
+// Rules are kept for all services, so that the compiled file does not depend
+// on the current service
+struct RelationRule {
+  std::array<int, 3> source_ids;  // MyAnimeList, Kitsu, AniList
+  std::pair<int, int> source_range;
+  std::array<int, 3> destination_ids;
+  std::pair<int, int> destination_range;
+  bool redirect_destination;
+};
+
+struct RelationData {
+  std::wstring version;
+  std::wstring last_modified;
+  std::vector<RelationRule> rules;
+};
+
+constexpr uint32_t kRelationsMagic = 0x4c455241;  // "AREL"
+constexpr uint32_t kRelationsVersion = 1;
 
 ////////////////////////////////////////////////////////////////////////////////
 
 void Relation::AddRange(int id, int_pair_t r1, int_pair_t r2) {
-  ranges_.push_back({id, r1, r2});
+  ranges_.push_back({id, r1, r2, ranges_.size()});
 }
 
-bool Relation::FindRange(int episode_number, int_pair_t& result) const {
-  for (const auto& it : ranges_) {
+void Relation::BuildIndex() {
+  std::stable_sort(ranges_.begin(), ranges_.end(),
+      [](const Range& a, const Range& b) {
+        return a.r0.first < b.r0.first;
+      });
+
+  max_last_episodes_.resize(ranges_.size());
+  for (size_t i = 0; i < ranges_.size(); ++i) {
+    max_last_episodes_[i] = i > 0 ?
+        std::max(max_last_episodes_[i - 1], ranges_[i].r0.second) :
+        ranges_[i].r0.second;
+  }
+}
+
+bool Relation::FindRange(int episode_number, int_pair_t& result,
+                         size_t& examined) const {
+  // Only the ranges that start at or before the episode can contain it
+  const auto end = std::upper_bound(ranges_.begin(), ranges_.end(),
+      episode_number, [](int episode_number, const Range& range) {
+        return episode_number < range.r0.first;
+      });
+
+  // Rules are matched in the order they were defined in
+  const Range* found = nullptr;
+  int found_destination = 0;
+
+  for (size_t i = end - ranges_.begin(); i-- > 0; ) {
+    if (max_last_episodes_[i] < episode_number)
+      break;
+    ++examined;
+    const auto& it = ranges_[i];
+    if (found && found->order < it.order)
+      continue;
     int distance = episode_number - it.r0.first;
     if (distance >= 0) {
       if (it.r0.second - episode_number >= 0) {
@@ -66,94 +130,106 @@ bool Relation::FindRange(int episode_number, int_pair_t& result) const {
         if (it.r1.first != it.r1.second)
           destination += distance;
         if (destination <= it.r1.second) {
-          result.first = it.id;
-          result.second = destination;
-          return true;
+          found = &it;
+          found_destination = destination;
         }
       }
     }
   }
 
-  return false;
+  if (!found)
+    return false;
+
+  result.first = found->id;
+  result.second = found_destination;
+  return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-static bool ParseRule(const std::wstring& rule) {
-  constexpr auto id_pattern = L"((?:\\d+|[?~])(?:\\|(?:\\d+|[?~]))*)";
-  constexpr auto episode_pattern = L"(\\d+)(?:-(\\d+|\\?))?";
-  static const std::wregex pattern(
-      L"{0}:{1} -> {0}:{1}(!)?"_format(id_pattern, episode_pattern));
-
-  std::match_results<std::wstring::const_iterator> match_results;
+// Parses rules in the form of "ids:episodes -> ids:episodes", where IDs are
+// separated by "|", unknown IDs are marked with "?" or "~", and the episode
+// ranges are in the form of "n", "n-m" or "n-?". A trailing "!" means that the
+// destination redirects to itself as well.
+class RuleParser {
+public:
+  explicit RuleParser(const std::wstring& rule) : rule_(rule) {}
+
+  bool Parse(RelationRule& result) {
+    return ParseIds(result.source_ids) &&
+           ParseChar(L':') &&
+           ParseRange(result.source_range) &&
+           ParseString(L" -> ") &&
+           ParseIds(result.destination_ids) &&
+           ParseChar(L':') &&
+           ParseRange(result.destination_range) &&
+           ParseEnd(result.redirect_destination);
+  }
 
-  if (!std::regex_match(rule, match_results, pattern))
+private:
+  bool ParseChar(wchar_t c) {
+    if (pos_ < rule_.size() && rule_[pos_] == c) {
+      ++pos_;
+      return true;
+    }
     return false;
+  }
 
-  auto get_id = [&](size_t index) {
-    std::vector<std::wstring> ids;
-    Split(match_results[index].str(), L"|", ids);
-    switch (taiga::GetCurrentServiceId()) {
-      case sync::kMyAnimeList:
-        return ids.size() > 0 ? ToInt(ids.at(0)) : 0;
-      case sync::kKitsu:
-        return ids.size() > 1 ? ToInt(ids.at(1)) : 0;
-      case sync::kAniList:
-        return ids.size() > 2 ? ToInt(ids.at(2)) : 0;
-      default:
-        return 0;
+  bool ParseString(const wchar_t* str) {
+    for (; *str; ++str) {
+      if (!ParseChar(*str))
+        return false;
     }
-  };
+    return true;
+  }
 
-  auto get_range = [&](size_t first, size_t second) {
-    std::pair<int, int> range;
-    range.first = ToInt(match_results[first].str());
-    if (match_results[second].matched) {
-      if (IsNumericString(match_results[second].str())) {
-        range.second = ToInt(match_results[second].str());
-      } else {
-        range.second = INT_MAX;
-      }
-    } else {
-      range.second = range.first;
+  bool ParseNumber(int& value) {
+    const size_t begin = pos_;
+    value = 0;
+    while (pos_ < rule_.size() && IsNumericChar(rule_[pos_])) {
+      const int digit = rule_[pos_++] - L'0';
+      value = value > (INT_MAX - digit) / 10 ? INT_MAX : value * 10 + digit;
     }
-    return range;
-  };
-
-  const int id0 = get_id(1);
-  if (id0) {
-    const auto r0 = get_range(2, 3);
-
-    int id1 = get_id(4);
-    if (!id1)
-      id1 = id0;
-    const auto r1 = get_range(5, 6);
-
-    relations[id0].AddRange(id1, r0, r1);
-
-    if (match_results[7].matched)
-      relations[id1].AddRange(id1, r0, r1);
+    return pos_ > begin;
   }
 
-  return true;
-}
-
-bool Engine::ReadRelations() {
-  std::wstring path = taiga::GetPath(taiga::Path::DatabaseAnimeRelations);
-  std::string document;
+  bool ParseIds(std::array<int, 3>& ids) {
+    ids.fill(0);
+    size_t index = 0;
+    do {
+      int id = 0;
+      if (!ParseChar(L'?') && !ParseChar(L'~') && !ParseNumber(id))
+        return false;
+      if (index < ids.size())
+        ids[index++] = id;
+    } while (ParseChar(L'|'));
+    return true;
+  }
 
-  if (!ReadFromFile(path, document)) {
-    LOGW(L"Could not read anime relations data.");
-    Settings.Set(taiga::kRecognition_RelationsLastModified, std::wstring());
-    return false;
+  bool ParseRange(std::pair<int, int>& range) {
+    if (!ParseNumber(range.first))
+      return false;
+    range.second = range.first;
+    if (ParseChar(L'-')) {
+      if (ParseChar(L'?')) {
+        range.second = INT_MAX;
+      } else if (!ParseNumber(range.second)) {
+        return false;
+      }
+    }
+    return true;
   }
 
-  return ReadRelations(document);
-}
+  bool ParseEnd(bool& redirect) {
+    redirect = ParseChar(L'!');
+    return pos_ == rule_.size();
+  }
 
-bool Engine::ReadRelations(const std::string& document) {
-  relations.clear();
+  const std::wstring& rule_;
+  size_t pos_ = 0;
+};
 
+static void ParseRelations(const std::string& document, RelationData& data) {
   std::vector<std::wstring> lines;
   Split(StrToWstr(document), L"\n", lines);
 
@@ -193,25 +269,183 @@ bool Engine::ReadRelations(const std::string& document) {
           auto name = match_results[1].str();
           auto value = match_results[2].str();
           if (name == L"version") {
-            semaver::Version version(WstrToStr(value));
-            if (version > Taiga.version)
-              LOGD(L"Anime relations version is larger than application version.");
+            data.version = value;
           } else if (name == L"last_modified") {
-            Settings.Set(taiga::kRecognition_RelationsLastModified, value);
+            data.last_modified = value;
           }
         }
         break;
       }
       case FileSection::Rules: {
         TrimLeft(line, L"- ");
-        if (!ParseRule(line))
+        RelationRule rule;
+        if (RuleParser(line).Parse(rule)) {
+          data.rules.push_back(rule);
+        } else {
           LOGW(L"Could not parse rule: {}", line);
+        }
         break;
       }
     }
   }
+}
+
+static bool ReadCompiledRelations(uint64_t checksum, RelationData& data) {
+  FileMapping file;
+  if (!file.Open(taiga::GetPath(taiga::Path::DatabaseAnimeRelationsCompiled)))
+    return false;
+
+  base::BinaryReader reader(file.data(), file.size());
+
+  uint32_t magic = 0;
+  uint32_t version = 0;
+  uint64_t file_checksum = 0;
+  uint32_t count = 0;
+  if (!reader.ReadUInt32(magic) || magic != kRelationsMagic ||
+      !reader.ReadUInt32(version) || version != kRelationsVersion ||
+      !reader.ReadUInt64(file_checksum) || file_checksum != checksum ||
+      !reader.ReadString(data.version) ||
+      !reader.ReadString(data.last_modified) ||
+      !reader.ReadUInt32(count)) {
+    return false;
+  }
 
-  return !relations.empty();
+  auto read_ids = [&reader](std::array<int, 3>& ids) {
+    for (auto& id : ids) {
+      if (!reader.ReadInt32(id))
+        return false;
+    }
+    return true;
+  };
+  auto read_range = [&reader](std::pair<int, int>& range) {
+    return reader.ReadInt32(range.first) && reader.ReadInt32(range.second);
+  };
+
+  for (uint32_t i = 0; i < count; ++i) {
+    RelationRule rule;
+    uint32_t redirect = 0;
+    if (!read_ids(rule.source_ids) || !read_range(rule.source_range) ||
+        !read_ids(rule.destination_ids) ||
+        !read_range(rule.destination_range) ||
+        !reader.ReadUInt32(redirect)) {
+      return false;
+    }
+    rule.redirect_destination = redirect != 0;
+    data.rules.push_back(rule);
+  }
+
+  return !reader.remaining();
+}
+
+static bool WriteCompiledRelations(uint64_t checksum,
+                                   const RelationData& data) {
+  base::BinaryWriter writer;
+  writer.WriteUInt32(kRelationsMagic);
+  writer.WriteUInt32(kRelationsVersion);
+  writer.WriteUInt64(checksum);
+  writer.WriteString(data.version);
+  writer.WriteString(data.last_modified);
+  writer.WriteUInt32(static_cast<uint32_t>(data.rules.size()));
+
+  auto write_ids = [&writer](const std::array<int, 3>& ids) {
+    for (const auto& id : ids)
+      writer.WriteInt32(id);
+  };
+  auto write_range = [&writer](const std::pair<int, int>& range) {
+    writer.WriteInt32(range.first);
+    writer.WriteInt32(range.second);
+  };
+
+  for (const auto& rule : data.rules) {
+    write_ids(rule.source_ids);
+    write_range(rule.source_range);
+    write_ids(rule.destination_ids);
+    write_range(rule.destination_range);
+    writer.WriteUInt32(rule.redirect_destination ? 1 : 0);
+  }
+
+  return SaveToFile(writer.data(),
+      taiga::GetPath(taiga::Path::DatabaseAnimeRelationsCompiled));
+}
+
+static int GetServiceId(const std::array<int, 3>& ids) {
+  switch (taiga::GetCurrentServiceId()) {
+    case sync::kMyAnimeList:
+      return ids[0];
+    case sync::kKitsu:
+      return ids[1];
+    case sync::kAniList:
+      return ids[2];
+    default:
+      return 0;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Engine::ReadRelations() {
+  std::wstring path = taiga::GetPath(taiga::Path::DatabaseAnimeRelations);
+  std::string document;
+
+  if (!ReadFromFile(path, document)) {
+    LOGW(L"Could not read anime relations data.");
+    Settings.Set(taiga::kRecognition_RelationsLastModified, std::wstring());
+    return false;
+  }
+
+  return ReadRelations(document);
+}
+
+bool Engine::ReadRelations(const std::string& document,
+                           bool use_compiled_data) {
+  base::Checksum checksum;
+  checksum.Update(document.data(), document.size());
+
+  // Parsing is skipped if the document has been compiled before
+  RelationData data;
+  if (!use_compiled_data || !ReadCompiledRelations(checksum.value(), data)) {
+    data = RelationData();
+    ParseRelations(document, data);
+    if (use_compiled_data)
+      WriteCompiledRelations(checksum.value(), data);
+  }
+
+  if (!data.version.empty()) {
+    semaver::Version version(WstrToStr(data.version));
+    if (version > Taiga.version)
+      LOGD(L"Anime relations version is larger than application version.");
+  }
+  if (!data.last_modified.empty())
+    Settings.Set(taiga::kRecognition_RelationsLastModified, data.last_modified);
+
+  auto new_relations = std::make_shared<relations_t>();
+
+  for (const auto& rule : data.rules) {
+    const int id0 = GetServiceId(rule.source_ids);
+    if (id0) {
+      int id1 = GetServiceId(rule.destination_ids);
+      if (!id1)
+        id1 = id0;
+      const auto& r0 = rule.source_range;
+      const auto& r1 = rule.destination_range;
+
+      (*new_relations)[id0].AddRange(id1, r0, r1);
+
+      if (rule.redirect_destination)
+        (*new_relations)[id1].AddRange(id1, r0, r1);
+    }
+  }
+
+  for (auto& it : *new_relations)
+    it.second.BuildIndex();
+
+  const bool result = !new_relations->empty();
+  std::atomic_store(&relations,
+      std::shared_ptr<const relations_t>(std::move(new_relations)));
+
+  InvalidateCache();
+
+  return result;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -219,31 +453,41 @@ bool Engine::ReadRelations(const std::string& document) {
 bool Engine::SearchEpisodeRedirection(
     int id, const std::pair<int, int>& range,
     int& destination_id, std::pair<int, int>& destination_range) const {
+  const auto start = std::chrono::steady_clock::now();
+  size_t examined = 0;  // ranges that were compared against the episodes
 
-  auto it = relations.find(id);
+  auto search = [&]() {
+    const auto current_relations = std::atomic_load(&relations);
 
-  if (it == relations.end())
-    return false;
+    auto it = current_relations->find(id);
 
-  const auto& relation = it->second;
+    if (it == current_relations->end())
+      return false;
 
-  std::pair<std::pair<int, int>, std::pair<int, int>> results;
+    const auto& relation = it->second;
 
-  if (!relation.FindRange(range.first, results.first))
-    return false;
+    std::pair<std::pair<int, int>, std::pair<int, int>> results;
 
-  if (range.first != range.second) {
-    if (!relation.FindRange(range.second, results.second))
+    if (!relation.FindRange(range.first, results.first, examined))
       return false;
-    if (results.first.first != results.second.first)
-      return false;
-  }
 
-  destination_id = results.first.first;
-  destination_range.first = results.first.second;
-  destination_range.second = results.second.second;
+    if (range.first != range.second) {
+      if (!relation.FindRange(range.second, results.second, examined))
+        return false;
+      if (results.first.first != results.second.first)
+        return false;
+    }
 
-  return true;
+    destination_id = results.first.first;
+    destination_range.first = results.first.second;
+    destination_range.second = results.second.second;
+
+    return true;
+  };
+
+  const bool found = search();
+  RecordStage(Stage::Redirection, examined, found, start);
+  return found;
 }
 
 }  // namespace recognition
@@ -17,6 +17,7 @@
 */
 
 #include <algorithm>
+#include <array>
 
 #include "base/string.h"
 #include "library/anime_db.h"
@@ -31,10 +32,14 @@ sorted_scores_t Engine::GetScores() const {
   return scores_;
 }
 
-int Engine::ScoreTitle(anime::Episode& episode, const std::set<int>& anime_ids,
-                       const MatchOptions& match_options) {
+int Engine::ScoreTitle(const TitleTables& tables, anime::Episode& episode,
+                       const std::set<int>& anime_ids,
+                       const MatchOptions& match_options,
+                       sorted_scores_t& scores) const {
   scores_t trigram_results;
 
+  const auto start = std::chrono::steady_clock::now();
+
   auto normal_title = episode.anime_title();
   Normalize(normal_title, kNormalizeForTrigrams, false);
 
@@ -42,8 +47,11 @@ int Engine::ScoreTitle(anime::Episode& episode, const std::set<int>& anime_ids,
   GetTrigrams(normal_title, t1);
 
   auto calculate_trigram_results = [&](int anime_id) {
-    for (const auto& t2 : db_[anime_id].trigrams) {
-      double result = CompareTrigrams(t1, t2);
+    const auto range = tables.db.Find(anime_id);
+    for (auto i = range.begin; i < range.end; ++i) {
+      double result = CompareTrigrams(t1.data(), t1.size(),
+                                      range.trigrams(i),
+                                      range.trigram_count(i));
       if (result > 0.1) {
         auto& target = trigram_results[anime_id];
         target = std::max(target, result);
@@ -55,29 +63,46 @@ int Engine::ScoreTitle(anime::Episode& episode, const std::set<int>& anime_ids,
     for (const auto& id : anime_ids) {
       calculate_trigram_results(id);
     }
+    RecordStage(Stage::TrigramScoring, anime_ids.size(),
+                !trigram_results.empty(), start);
   } else {
-    for (const auto& it : AnimeDatabase.items) {
-      if (ValidateOptions(episode, it.second, match_options, false))
-        calculate_trigram_results(it.first);
+    // Titles that share no trigrams with the query would score zero, so we
+    // only need to check the anime that appear in the posting lists.
+    std::set<int> candidates;
+    for (const auto& trigram : t1) {
+      if (const auto ids = tables.trigram_index.find(trigram))
+        candidates.insert(ids->begin(), ids->end());
+    }
+    for (const auto& id : candidates) {
+      auto anime_item = AnimeDatabase.FindItem(id, false);
+      if (anime_item &&
+          ValidateOptions(episode, *anime_item, match_options, false))
+        calculate_trigram_results(id);
     }
+    RecordStage(Stage::DatabaseScoring, candidates.size(),
+                !trigram_results.empty(), start);
   }
 
-  return ScoreTitle(normal_title, episode, trigram_results);
+  return ScoreTitle(tables, normal_title, episode, trigram_results, scores);
 }
 
-static double CustomScore(const std::wstring& title, const std::wstring& str) {
+static double CustomScore(std::wstring_view title,
+                          const PatternMatchVector& pattern) {
+  const std::wstring_view str = pattern.str();
+
   double length_min = std::min(title.size(), str.size());
   double length_max = std::max(title.size(), str.size());
   double length_ratio = length_min / length_max;
 
   double score = 0.0;
 
-  if (StartsWith(title, str) || StartsWith(str, title)) {
+  if (title.compare(0, str.size(), str) == 0 ||
+      str.compare(0, title.size(), title) == 0) {
     score = length_ratio;
-  } else if (InStr(title, str) > -1 || InStr(str, title) > -1) {
+  } else if (title.find(str) != title.npos || str.find(title) != str.npos) {
     score = length_ratio * 0.9;
   } else {
-    auto length_lcs = LongestCommonSubsequenceLength(title, str);
+    auto length_lcs = LongestCommonSubsequenceLength(title, pattern);
     auto lcs_score = length_lcs / length_max;
     score = lcs_score * 0.8;
 
@@ -112,50 +137,321 @@ static double BonusScore(const anime::Episode& episode, int id) {
   return score;
 };
 
-int Engine::ScoreTitle(const std::wstring& str, const anime::Episode& episode,
-                       const scores_t& trigram_results) {
-  scores_t jaro_winkler, levenshtein, custom, bonus;
+// Upper bound of the string metrics that can be calculated for two strings,
+// which only depends on the ratio of their lengths. See CustomScore,
+// JaroWinklerDistance and LevenshteinDistance for the derivations.
+static double MaxStringScore(double length_ratio) {
+  const double jaro = (2.0 + length_ratio) / 3.0;
+  const double jaro_winkler = jaro + (4 * 0.1 * (1.0 - jaro));
+  const double custom = std::max(length_ratio, 0.7);
+  const double levenshtein = length_ratio;
+
+  return (1.0 * jaro_winkler) +
+         (0.5 * std::pow(custom, 0.66)) +
+         (0.3 * std::pow(levenshtein, 0.8));
+}
+
+int Engine::ScoreTitle(const TitleTables& tables, const std::wstring& str,
+                       const anime::Episode& episode,
+                       const scores_t& trigram_results,
+                       sorted_scores_t& scores) const {
+  constexpr size_t kMaxResults = 20;
+  constexpr double kMinScore = 0.3;
+
+  const auto start = std::chrono::steady_clock::now();
+
+  struct Candidate {
+    int id;
+    double trigram_score;
+    double bonus;
+    double max_score;
+    size_t order;
+  };
+
+  struct Result {
+    int id;
+    double score;
+    size_t order;
+  };
+
+  // Equal scores are ordered by their position in the trigram results
+  auto is_better = [](const Result& a, const Result& b) {
+    return a.score > b.score || (a.score == b.score && a.order < b.order);
+  };
 
-  scores_.clear();
+  // Calculate cheap upper bounds first, so that we can skip the candidates
+  // that cannot make it into the results
+  std::vector<Candidate> candidates;
+  candidates.reserve(trigram_results.size());
 
   for (const auto& trigram_result : trigram_results) {
-    int id = trigram_result.first;
+    const int id = trigram_result.first;
+
+    double length_ratio = 0.0;
+    const auto range = tables.db.Find(id);
+    for (auto i = range.begin; i < range.end; ++i) {
+      const size_t title_length = range.title_length(i);
+      const auto length_max = std::max(title_length, str.size());
+      const auto length_min = std::min(title_length, str.size());
+      length_ratio = std::max(length_ratio, length_max ?
+          static_cast<double>(length_min) / length_max : 1.0);
+    }
+
+    Candidate candidate;
+    candidate.id = id;
+    candidate.trigram_score = trigram_result.second;
+    candidate.bonus = BonusScore(episode, id);
+    candidate.max_score =
+        ((MaxStringScore(length_ratio) +
+          (0.2 * std::pow(candidate.trigram_score, 0.8))) / 2.0) +
+        candidate.bonus + 1e-9;  // Allow for rounding errors
+    candidate.order = candidates.size();
+    candidates.push_back(candidate);
+  }
+
+  std::sort(candidates.begin(), candidates.end(),
+      [](const Candidate& a, const Candidate& b) {
+        return a.max_score > b.max_score;
+      });
+
+  // The worst of the best results is kept at the top of the heap
+  std::vector<Result> results;
+  results.reserve(kMaxResults + 1);
+
+  const PatternMatchVector pattern(str);
+
+  for (const auto& candidate : candidates) {
+    if (candidate.max_score < kMinScore)
+      break;
+    if (results.size() == kMaxResults &&
+        candidate.max_score < results.front().score)
+      break;
+
+    const int id = candidate.id;
+    double jaro_winkler = 0.0;
+    double levenshtein = 0.0;
+    double custom = 0.0;
 
     // Calculate individual scores for all titles
-    for (auto& title : db_[id].normal_titles) {
-      jaro_winkler[id] = std::max(jaro_winkler[id], JaroWinklerDistance(title, str));
-      levenshtein[id] = std::max(levenshtein[id], LevenshteinDistance(title, str));
-      custom[id] = std::max(custom[id], CustomScore(title, str));
+    const auto range = tables.db.Find(id);
+    for (auto i = range.begin; i < range.end; ++i) {
+      const auto title = range.title(i);
+      jaro_winkler = std::max(jaro_winkler, JaroWinklerDistance(title, pattern));
+      levenshtein = std::max(levenshtein, LevenshteinDistance(title, pattern));
+      custom = std::max(custom, CustomScore(title, pattern));
     }
-    bonus[id] = BonusScore(episode, id);
 
     // Calculate the average score for the ID
     double score =
-        (((1.0 * jaro_winkler[id]) +
-          (0.5 * std::pow(custom[id], 0.66)) +
-          (0.3 * std::pow(levenshtein[id], 0.8)) +
-          (0.2 * std::pow(trigram_result.second, 0.8))) / 2.0) + bonus[id];
-    if (score >= 0.3)
-      scores_.push_back(std::make_pair(id, score));
+        (((1.0 * jaro_winkler) +
+          (0.5 * std::pow(custom, 0.66)) +
+          (0.3 * std::pow(levenshtein, 0.8)) +
+          (0.2 * std::pow(candidate.trigram_score, 0.8))) / 2.0) +
+        candidate.bonus;
+    if (!(score >= kMinScore))
+      continue;
+
+    const Result result{id, score, candidate.order};
+    if (results.size() < kMaxResults) {
+      results.push_back(result);
+      std::push_heap(results.begin(), results.end(), is_better);
+    } else if (is_better(result, results.front())) {
+      std::pop_heap(results.begin(), results.end(), is_better);
+      results.back() = result;
+      std::push_heap(results.begin(), results.end(), is_better);
+    }
   }
 
-  // Sort scores in descending order, then limit the results
-  std::stable_sort(scores_.begin(), scores_.end(),
-      [&](const std::pair<int, double>& a,
-          const std::pair<int, double>& b) {
-        return a.second > b.second;
-      });
-  if (scores_.size() > 20)
-    scores_.resize(20);
+  // Sort scores in descending order
+  std::sort_heap(results.begin(), results.end(), is_better);
+
+  scores.clear();
+  for (const auto& result : results)
+    scores.push_back(std::make_pair(result.id, result.score));
+
+  double score_1st = scores.size() > 0 ? scores.at(0).second : 0.0;
+  double score_2nd = scores.size() > 1 ? scores.at(1).second : 0.0;
+
+  const int anime_id = score_1st >= 1.0 && score_1st != score_2nd ?
+      scores.front().first : anime::ID_UNKNOWN;
+
+  RecordStage(Stage::FinalScoring, trigram_results.size(),
+              anime::IsValidId(anime_id), start);
 
-  double score_1st = scores_.size() > 0 ? scores_.at(0).second : 0.0;
-  double score_2nd = scores_.size() > 1 ? scores_.at(1).second : 0.0;
+  return anime_id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+class Engine::ScoreStore::Chunk {
+public:
+  void Assign(size_t offset, const std::vector<std::wstring>& titles,
+              const std::vector<trigram_container_t>& trigrams);
+  Range Find(size_t offset) const;
+  bool empty() const;
+
+  std::wstring_view title(uint32_t index) const;
+  uint32_t title_length(uint32_t index) const;
+  const trigram_t* trigrams(uint32_t index) const;
+  uint32_t trigram_count(uint32_t index) const;
+
+private:
+  void Compact();
 
-  if (score_1st >= 1.0 && score_1st != score_2nd)
-    return scores_.front().first;
+  std::array<Range, kChunkSize> ranges_;  // Indexed by ID offset in the chunk
+  std::vector<uint32_t> title_offsets_;
+  std::vector<uint32_t> title_lengths_;
+  std::vector<uint32_t> trigram_offsets_;
+  std::vector<uint32_t> trigram_counts_;
+  std::vector<wchar_t> text_;
+  std::vector<trigram_t> trigrams_;
+  size_t unused_titles_ = 0;  // Left behind by reassigned IDs
+};
+
+void Engine::ScoreStore::Chunk::Assign(
+    size_t offset, const std::vector<std::wstring>& titles,
+    const std::vector<trigram_container_t>& trigrams) {
+  // Previous titles of the ID are left in place until the next compaction
+  auto& range = ranges_[offset];
+  unused_titles_ += range.end - range.begin;
 
+  range.begin = static_cast<uint32_t>(title_offsets_.size());
+  for (size_t i = 0; i < titles.size(); ++i) {
+    const auto& title = titles.at(i);
+    const auto& title_trigrams = trigrams.at(i);
+    title_offsets_.push_back(static_cast<uint32_t>(text_.size()));
+    title_lengths_.push_back(static_cast<uint32_t>(title.size()));
+    text_.insert(text_.end(), title.begin(), title.end());
+    trigram_offsets_.push_back(static_cast<uint32_t>(trigrams_.size()));
+    trigram_counts_.push_back(static_cast<uint32_t>(title_trigrams.size()));
+    trigrams_.insert(trigrams_.end(),
+                     title_trigrams.begin(), title_trigrams.end());
+  }
+  range.end = static_cast<uint32_t>(title_offsets_.size());
+
+  if (unused_titles_ > 64 && unused_titles_ > title_offsets_.size() / 2)
+    Compact();
+}
+
+Engine::ScoreStore::Range Engine::ScoreStore::Chunk::Find(
+    size_t offset) const {
+  auto range = ranges_[offset];
+  range.chunk = this;
+  return range;
+}
+
+bool Engine::ScoreStore::Chunk::empty() const {
+  return title_offsets_.size() == unused_titles_;
+}
+
+std::wstring_view Engine::ScoreStore::Chunk::title(uint32_t index) const {
+  return std::wstring_view(text_.data() + title_offsets_[index],
+                           title_lengths_[index]);
+}
+
+uint32_t Engine::ScoreStore::Chunk::title_length(uint32_t index) const {
+  return title_lengths_[index];
+}
+
+const trigram_t* Engine::ScoreStore::Chunk::trigrams(uint32_t index) const {
+  return trigrams_.data() + trigram_offsets_[index];
+}
+
+uint32_t Engine::ScoreStore::Chunk::trigram_count(uint32_t index) const {
+  return trigram_counts_[index];
+}
+
+void Engine::ScoreStore::Chunk::Compact() {
+  Chunk chunk;
+  chunk.title_offsets_.reserve(title_offsets_.size() - unused_titles_);
+  chunk.title_lengths_.reserve(title_lengths_.size() - unused_titles_);
+  chunk.trigram_offsets_.reserve(trigram_offsets_.size() - unused_titles_);
+  chunk.trigram_counts_.reserve(trigram_counts_.size() - unused_titles_);
+
+  for (size_t offset = 0; offset < ranges_.size(); ++offset) {
+    const auto& range = ranges_[offset];
+    auto& new_range = chunk.ranges_[offset];
+    new_range.begin = static_cast<uint32_t>(chunk.title_offsets_.size());
+    for (auto i = range.begin; i < range.end; ++i) {
+      const auto title_begin = text_.begin() + title_offsets_[i];
+      const auto trigrams_begin = trigrams_.begin() + trigram_offsets_[i];
+      chunk.title_offsets_.push_back(
+          static_cast<uint32_t>(chunk.text_.size()));
+      chunk.title_lengths_.push_back(title_lengths_[i]);
+      chunk.text_.insert(chunk.text_.end(),
+                         title_begin, title_begin + title_lengths_[i]);
+      chunk.trigram_offsets_.push_back(
+          static_cast<uint32_t>(chunk.trigrams_.size()));
+      chunk.trigram_counts_.push_back(trigram_counts_[i]);
+      chunk.trigrams_.insert(chunk.trigrams_.end(),
+                             trigrams_begin,
+                             trigrams_begin + trigram_counts_[i]);
+    }
+    new_range.end = static_cast<uint32_t>(chunk.title_offsets_.size());
+  }
+
+  *this = std::move(chunk);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Engine::ScoreStore::Assign(
+    int id, const std::vector<std::wstring>& titles,
+    const std::vector<trigram_container_t>& trigrams) {
+  if (!anime::IsValidId(id))
+    return;
+
+  const size_t index = id / kChunkSize;
+  if (index >= chunks_.size())
+    chunks_.resize(index + 1);
+
+  // A chunk that no other store refers to can be modified in place
+  auto& chunk = chunks_[index];
+  if (!chunk) {
+    if (titles.empty())
+      return;
+    chunk = std::make_shared<Chunk>();
+  } else if (chunk.use_count() > 1) {
+    chunk = std::make_shared<Chunk>(*chunk);
+  }
+
+  chunk->Assign(id % kChunkSize, titles, trigrams);
+}
+
+Engine::ScoreStore::Range Engine::ScoreStore::Find(int id) const {
+  if (!anime::IsValidId(id))
+    return Range();
+
+  const size_t index = id / kChunkSize;
+  if (index >= chunks_.size() || !chunks_[index])
+    return Range();
+
+  return chunks_[index]->Find(id % kChunkSize);
+}
+
+int Engine::ScoreStore::max_id() const {
+  for (size_t index = chunks_.size(); index > 0; --index) {
+    if (chunks_[index - 1] && !chunks_[index - 1]->empty())
+      return static_cast<int>(index * kChunkSize - 1);
+  }
   return anime::ID_UNKNOWN;
 }
 
+std::wstring_view Engine::ScoreStore::Range::title(uint32_t index) const {
+  return chunk->title(index);
+}
+
+uint32_t Engine::ScoreStore::Range::title_length(uint32_t index) const {
+  return chunk->title_length(index);
+}
+
+const trigram_t* Engine::ScoreStore::Range::trigrams(uint32_t index) const {
+  return chunk->trigrams(index);
+}
+
+uint32_t Engine::ScoreStore::Range::trigram_count(uint32_t index) const {
+  return chunk->trigram_count(index);
+}
+
 }  // namespace recognition
 }  // namespace track
\ No newline at end of file
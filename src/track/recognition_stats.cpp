@@ -0,0 +1,111 @@
+/*
+** Taiga
+** Copyright (C) 2010-2018, Eren Okka
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "base/log.h"
+#include "base/string.h"
+#include "track/recognition.h"
+
+namespace track {
+namespace recognition {
+
+const StageStats& EngineStats::at(Stage stage) const {
+  return stages.at(static_cast<size_t>(stage));
+}
+
+std::wstring GetStageName(Stage stage) {
+  switch (stage) {
+    case Stage::MergedTitleLookup: return L"Merged title lookup";
+    case Stage::TitleLookup: return L"Title lookup";
+    case Stage::DirectoryLookup: return L"Parent directory lookup";
+    case Stage::TypoLookup: return L"Typo lookup";
+    case Stage::Redirection: return L"Episode redirection";
+    case Stage::TrigramScoring: return L"Trigram scoring";
+    case Stage::DatabaseScoring: return L"Trigram scoring (database)";
+    case Stage::FinalScoring: return L"Final scoring";
+  }
+  return std::wstring();
+}
+
+std::wstring FormatEngineStats(const EngineStats& stats) {
+  std::wstring text = L"Identify calls: " +
+                      ToWstr(stats.identify_calls) + L"\r\n";
+
+  for (size_t i = 0; i < kStageCount; ++i) {
+    const auto& stage = stats.stages.at(i);
+    const double average = stage.calls ?
+        static_cast<double>(stage.microseconds) / stage.calls : 0.0;
+    text += GetStageName(static_cast<Stage>(i)) + L": " +
+            ToWstr(stage.calls) + L" calls, " +
+            ToWstr(stage.successes) + L" succeeded, " +
+            ToWstr(stage.candidates) + L" candidates, " +
+            ToWstr(stage.microseconds / 1000) + L" ms total, " +
+            ToWstr(average, 1) + L" us average\r\n";
+  }
+
+  return text;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Engine::RecordStage(Stage stage, size_t candidates, bool success,
+                         std::chrono::steady_clock::time_point start) const {
+  const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  auto& counters = stage_counters_.at(static_cast<size_t>(stage));
+  counters.calls.fetch_add(1, std::memory_order_relaxed);
+  counters.candidates.fetch_add(candidates, std::memory_order_relaxed);
+  if (success)
+    counters.successes.fetch_add(1, std::memory_order_relaxed);
+  counters.microseconds.fetch_add(elapsed.count(), std::memory_order_relaxed);
+}
+
+EngineStats Engine::GetStats() const {
+  EngineStats stats;
+
+  stats.identify_calls = identify_calls_.load(std::memory_order_relaxed);
+
+  for (size_t i = 0; i < kStageCount; ++i) {
+    const auto& counters = stage_counters_.at(i);
+    auto& stage = stats.stages.at(i);
+    stage.calls = counters.calls.load(std::memory_order_relaxed);
+    stage.candidates = counters.candidates.load(std::memory_order_relaxed);
+    stage.successes = counters.successes.load(std::memory_order_relaxed);
+    stage.microseconds = counters.microseconds.load(std::memory_order_relaxed);
+  }
+
+  return stats;
+}
+
+void Engine::ResetStats() {
+  identify_calls_.store(0, std::memory_order_relaxed);
+
+  for (auto& counters : stage_counters_) {
+    counters.calls.store(0, std::memory_order_relaxed);
+    counters.candidates.store(0, std::memory_order_relaxed);
+    counters.successes.store(0, std::memory_order_relaxed);
+    counters.microseconds.store(0, std::memory_order_relaxed);
+  }
+}
+
+void Engine::LogStats() const {
+  LOGD(L"Recognition stats:\n{}", FormatEngineStats(GetStats()));
+}
+
+}  // namespace recognition
+}  // namespace track
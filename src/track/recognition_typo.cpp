@@ -0,0 +1,294 @@
+/*
+** Taiga
+** Copyright (C) 2010-2018, Eren Okka
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "base/string.h"
+#include "library/anime_util.h"
+#include "track/recognition.h"
+
+namespace track {
+namespace recognition {
+
+// Finds the keys that are within a small edit distance of a query, based on
+// the symmetric delete algorithm of SymSpell. Two strings that are close to
+// each other share a variant with a few characters deleted from each, so we
+// only need to look up the variants of the query. Variants are limited to a
+// short prefix to keep the index small, and candidates are verified later.
+class TypoIndex {
+public:
+  explicit TypoIndex(std::vector<std::wstring> keys);
+
+  // Keys that the filter rejects are skipped
+  template <typename Filter>
+  size_t Find(const std::wstring& str, size_t max_distance, Filter filter,
+              std::vector<std::wstring>& keys) const;
+
+  bool Contains(const std::wstring& key) const;
+  size_t size() const;
+
+  static constexpr size_t kMaxDistance = 2;
+
+private:
+  static constexpr size_t kPrefixLength = 7;
+
+  template <typename Function>
+  static void ForEachVariant(const std::wstring& str, size_t max_deletions,
+                             Function function);
+
+  typedef std::pair<uint64_t, uint32_t> variant_t;  // Hash and key index
+
+  std::vector<std::wstring> keys_;
+  std::vector<variant_t> variants_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Numbers usually tell sequels apart, so they must not be mistaken for typos
+static bool HaveSameNumbers(const std::wstring& str1,
+                            const std::wstring& str2) {
+  auto it1 = str1.begin();
+  auto it2 = str2.begin();
+
+  while (true) {
+    it1 = std::find_if(it1, str1.end(), IsNumericChar);
+    it2 = std::find_if(it2, str2.end(), IsNumericChar);
+    if (it1 == str1.end() || it2 == str2.end())
+      return it1 == str1.end() && it2 == str2.end();
+    if (*it1++ != *it2++)
+      return false;
+  }
+}
+
+TypoIndex::TypoIndex(std::vector<std::wstring> keys)
+    : keys_(std::move(keys)) {
+  std::sort(keys_.begin(), keys_.end());
+  keys_.erase(std::unique(keys_.begin(), keys_.end()), keys_.end());
+
+  for (size_t i = 0; i < keys_.size(); ++i) {
+    const auto index = static_cast<uint32_t>(i);
+    ForEachVariant(keys_[i], kMaxDistance, [&](uint64_t hash) {
+      variants_.emplace_back(hash, index);
+    });
+  }
+
+  // Deleting different characters may result in the same variant
+  std::sort(variants_.begin(), variants_.end());
+  variants_.erase(std::unique(variants_.begin(), variants_.end()),
+                  variants_.end());
+  variants_.shrink_to_fit();
+}
+
+template <typename Filter>
+size_t TypoIndex::Find(const std::wstring& str, size_t max_distance,
+                       Filter filter, std::vector<std::wstring>& keys) const {
+  keys.clear();
+
+  max_distance = std::min(max_distance, kMaxDistance);
+  if (!max_distance)
+    return 0;
+
+  std::vector<uint32_t> candidates;
+  ForEachVariant(str, max_distance, [&](uint64_t hash) {
+    auto it = std::lower_bound(variants_.begin(), variants_.end(),
+                               variant_t{hash, 0});
+    for (; it != variants_.end() && it->first == hash; ++it)
+      candidates.push_back(it->second);
+  });
+
+  std::sort(candidates.begin(), candidates.end());
+  candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                   candidates.end());
+
+  const PatternMatchVector pattern(str);
+  size_t best_distance = max_distance + 1;
+
+  for (const auto index : candidates) {
+    const auto& key = keys_[index];
+    if (key.size() + max_distance < str.size() ||
+        str.size() + max_distance < key.size())
+      continue;
+    if (!HaveSameNumbers(key, str) || !filter(key))
+      continue;
+    const size_t distance = EditDistance(key, pattern);
+    if (!distance || distance > max_distance || distance > best_distance)
+      continue;
+    if (distance < best_distance) {
+      best_distance = distance;
+      keys.clear();
+    }
+    keys.push_back(key);
+  }
+
+  return keys.empty() ? 0 : best_distance;
+}
+
+bool TypoIndex::Contains(const std::wstring& key) const {
+  return std::binary_search(keys_.begin(), keys_.end(), key);
+}
+
+size_t TypoIndex::size() const {
+  return keys_.size();
+}
+
+// Calls the function with the hash of each variant of the prefix, including
+// the prefix itself
+template <typename Function>
+void TypoIndex::ForEachVariant(const std::wstring& str, size_t max_deletions,
+                               Function function) {
+  const size_t length = std::min(str.size(), kPrefixLength);
+  const size_t npos = std::wstring::npos;
+
+  // FNV-1a
+  auto hash = [&](size_t skip1, size_t skip2) {
+    uint64_t value = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; ++i) {
+      if (i == skip1 || i == skip2)
+        continue;
+      value ^= static_cast<uint64_t>(str[i]);
+      value *= 1099511628211ULL;
+    }
+    return value;
+  };
+
+  function(hash(npos, npos));
+
+  if (max_deletions < 1)
+    return;
+  for (size_t i = 0; i < length; ++i) {
+    function(hash(i, npos));
+    if (max_deletions < 2)
+      continue;
+    for (size_t j = i + 1; j < length; ++j)
+      function(hash(i, j));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int Engine::LookUpTypo(const TitleTables& tables, std::wstring title,
+                       std::set<int>& anime_ids) const {
+  // Short titles are too close to each other to guess
+  constexpr size_t kMinLength = 5;
+  constexpr size_t kMinLengthForTwoTypos = 12;
+
+  int anime_id = anime::ID_UNKNOWN;
+
+  Normalize(title, kNormalizeFull, false);
+
+  if (title.size() < kMinLength || !tables.typo_index)
+    return anime_id;
+
+  const auto containers = {
+    &tables.normal_titles.user,
+    &tables.normal_titles.main,
+    &tables.normal_titles.alternative,
+  };
+
+  // An exact match has already been found, and rejected
+  for (const auto container : containers) {
+    if (container->contains(title))
+      return anime_id;
+  }
+
+  // The index may still have keys that were removed from the tables
+  auto is_current_key = [&containers](const std::wstring& key) {
+    for (const auto container : containers) {
+      if (container->contains(key))
+        return true;
+    }
+    return false;
+  };
+
+  const size_t max_distance = title.size() < kMinLengthForTwoTypos ? 1 : 2;
+
+  std::vector<std::wstring> keys;
+  size_t distance = tables.typo_index->Find(title, max_distance,
+                                            is_current_key, keys);
+
+  if (tables.recent_typo_index) {
+    std::vector<std::wstring> recent_keys;
+    const size_t recent_distance = tables.recent_typo_index->Find(
+        title, distance ? distance : max_distance, is_current_key,
+        recent_keys);
+    if (recent_distance && (!distance || recent_distance < distance)) {
+      distance = recent_distance;
+      keys = std::move(recent_keys);
+    } else if (recent_distance == distance) {
+      keys.insert(keys.end(), recent_keys.begin(), recent_keys.end());
+    }
+  }
+
+  if (!distance)
+    return anime_id;
+
+  for (const auto& key : keys) {
+    for (const auto container : containers) {
+      if (const auto ids = container->find(key))
+        anime_ids.insert(ids->begin(), ids->end());
+    }
+  }
+
+  if (anime_ids.size() == 1)
+    anime_id = *anime_ids.begin();
+
+  return anime_id;
+}
+
+void Engine::AddTypoKey(TitleTables& tables, const std::wstring& key) const {
+  // Every key is indexed when the index is first built
+  if (!tables.typo_index || tables.typo_index->Contains(key))
+    return;
+
+  auto& keys = tables.recent_typo_keys;
+  if (std::find(keys.begin(), keys.end(), key) == keys.end())
+    keys.push_back(key);
+}
+
+void Engine::UpdateTypoIndex(TitleTables& tables) const {
+  // Rebuilding the index of all keys takes a while, so we only do it once
+  // enough keys have been added since the last time
+  constexpr size_t kMaxRecentKeys = 1024;
+
+  if (!tables.typo_index || tables.recent_typo_keys.size() > kMaxRecentKeys) {
+    std::vector<std::wstring> keys;
+    for (const auto container : {&tables.normal_titles.user,
+                                 &tables.normal_titles.main,
+                                 &tables.normal_titles.alternative}) {
+      container->for_each([&keys](const std::wstring& key,
+                                  const std::set<int>&) {
+        keys.push_back(key);
+      });
+    }
+    tables.typo_index = std::make_shared<TypoIndex>(std::move(keys));
+    tables.recent_typo_index.reset();
+    tables.recent_typo_keys.clear();
+
+  } else if (tables.recent_typo_keys.empty()) {
+    tables.recent_typo_index.reset();
+
+  } else if (!tables.recent_typo_index ||
+             tables.recent_typo_index->size() !=
+                 tables.recent_typo_keys.size()) {
+    tables.recent_typo_index =
+        std::make_shared<TypoIndex>(tables.recent_typo_keys);
+  }
+}
+
+}  // namespace recognition
+}  // namespace track
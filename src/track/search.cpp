@@ -42,18 +42,16 @@ bool TaigaFileSearchHelper::OnDirectory(const std::wstring& root,
   parse_options.parse_path = false;
   parse_options.streaming_media = false;
 
-  if (!Meow.Parse(name, parse_options, episode_)) {
-    LOGD(L"Could not parse directory: {}", name);
-    return false;
-  }
-
   static track::recognition::MatchOptions match_options;
   match_options.allow_sequels = false;
   match_options.check_airing_date = false;
   match_options.check_anime_type = false;
   match_options.check_episode_number = false;
 
-  Meow.Identify(episode_, false, match_options);
+  if (!Meow.Recognize(name, parse_options, match_options, episode_)) {
+    LOGD(L"Could not parse directory: {}", name);
+    return false;
+  }
 
   anime::Item* anime_item = AnimeDatabase.FindItem(episode_.anime_id);
 
@@ -80,18 +78,16 @@ bool TaigaFileSearchHelper::OnFile(const std::wstring& root,
   parse_options.parse_path = true;
   parse_options.streaming_media = false;
 
-  if (!Meow.Parse(path, parse_options, episode_)) {
-    LOGD(L"Could not parse filename: {}", name);
-    return false;
-  }
-
   static track::recognition::MatchOptions match_options;
   match_options.allow_sequels = true;
   match_options.check_airing_date = true;
   match_options.check_anime_type = true;
   match_options.check_episode_number = true;
 
-  Meow.Identify(episode_, false, match_options);
+  if (!Meow.Recognize(path, parse_options, match_options, episode_)) {
+    LOGD(L"Could not parse filename: {}", name);
+    return false;
+  }
 
   anime::Item* anime_item = AnimeDatabase.FindItem(episode_.anime_id);
 
@@ -177,6 +173,8 @@ void ScanAvailableEpisodes(bool silent, int anime_id, int episode_number) {
       Settings.GetInt(taiga::kLibrary_FileSizeThreshold));
   file_search_helper.set_path_found(L"");
 
+  Meow.BeginDirectoryScan();
+
   auto anime_item = AnimeDatabase.FindItem(anime_id);
   bool found = false;
 
@@ -222,6 +220,8 @@ void ScanAvailableEpisodes(bool silent, int anime_id, int episode_number) {
     }
   }
 
+  Meow.EndDirectoryScan();
+
   if (!silent) {
     ui::taskbar_list.SetProgressState(TBPF_NOPROGRESS);
     ui::SetSharedCursor(IDC_ARROW);
@@ -236,6 +236,8 @@ void ScanAvailableEpisodesQuick() {
 }
 
 void ScanAvailableEpisodesQuick(int anime_id) {
+  Meow.BeginDirectoryScan();
+
   foreach_r_(it, AnimeDatabase.items) {
     anime::Item& anime_item = it->second;
 
@@ -257,5 +259,7 @@ void ScanAvailableEpisodesQuick(int anime_id) {
     file_search_helper.Search(anime_item.GetFolder());
   }
 
+  Meow.EndDirectoryScan();
+
   ui::OnScanAvailableEpisodesFinished();
 }
\ No newline at end of file
@@ -246,9 +246,9 @@ LRESULT SeasonDialog::OnListNotify(LPARAM lParam) {
             text += ToWstr(anime_item->GetPopularity()) + L" users";
             break;
         }
-        if (!anime_item->GetGenres().empty())
+        if (anime_item->HasGenres())
           text += L"\n" + Join(anime_item->GetGenres(), L", ");
-        if (!anime_item->GetProducers().empty())
+        if (anime_item->HasProducers())
           text += L"\n" + Join(anime_item->GetProducers(), L", ");
         tooltips_.UpdateText(0, text.c_str());
       }
@@ -471,11 +471,11 @@ LRESULT SeasonDialog::OnListCustomDraw(LPARAM lParam) {
       text += L" (" + anime::TranslateStatus(anime_item->GetAiringStatus()) + L")";
       DRAWLINE(text);
       DRAWLINE(anime::TranslateNumber(anime_item->GetEpisodeCount(), L"Unknown"));
-      DRAWLINE(anime_item->GetGenres().empty() ? L"?" : Join(anime_item->GetGenres(), L", "));
+      DRAWLINE(!anime_item->HasGenres() ? L"?" : Join(anime_item->GetGenres(), L", "));
       switch (current_service) {
         case sync::kMyAnimeList:
         case sync::kAniList:
-          DRAWLINE(anime_item->GetProducers().empty() ? L"?" : Join(anime_item->GetProducers(), L", "));
+          DRAWLINE(!anime_item->HasProducers() ? L"?" : Join(anime_item->GetProducers(), L", "));
           break;
       }
       DRAWLINE(anime::TranslateScore(anime_item->GetScore()));
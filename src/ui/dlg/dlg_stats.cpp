@@ -25,6 +25,7 @@
 #include "taiga/resource.h"
 #include "taiga/settings.h"
 #include "taiga/stats.h"
+#include "track/recognition.h"
 #include "ui/dlg/dlg_stats.h"
 #include "ui/theme.h"
 #include "ui/ui.h"
@@ -226,6 +227,20 @@ void StatsDialog::Refresh() {
     text += L" (" + ToWstr(Stats.connections_failed) + L" failed)";
   text += L"\n";
   text += ToDateString(Stats.uptime) + L"\n";
+  const auto recognition_stats = Meow.GetStats();
+  const auto cache_stats = Meow.GetCacheStats();
+  // Results that are served from the cache do not go through Identify
+  text += ToWstr(recognition_stats.identify_calls + cache_stats.hits);
+  if (cache_stats.hits > 0)
+    text += L" (" + ToWstr(cache_stats.hits) + L" from cache)";
+  text += L"\n";
+  const auto& database_scoring =
+      recognition_stats.at(track::recognition::Stage::DatabaseScoring);
+  text += ToWstr(database_scoring.calls);
+  if (database_scoring.calls > 0)
+    text += L" (" + ToWstr(database_scoring.microseconds / 1000.0 /
+                           database_scoring.calls, 2) + L" ms average)";
+  text += L"\n";
   text += ToWstr(Stats.tigers_harmed);
   SetDlgItemText(IDC_STATIC_ANIME_STAT4, text.c_str());
 }